@@ -0,0 +1,664 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/////////////////////////////////////////////////////////////////////
+// MinimBench
+//
+// A standalone micro-benchmark for the hot paths in the library: every
+// UGen rendered through an AudioOutput, FFT::forward and FFT::inverse at each
+// power-of-two size, Wavetable::value, MultiChannelBuffer copies and,
+// when built with MINIM_BENCH_FILES, the libsndfile and mpg123 read loops.
+//
+// Each benchmark is run several times and the fastest run is reported, so that
+// the numbers are comparable from one build to the next. Output is CSV on stdout,
+// one row per benchmark:
+//
+//     group,name,size,iterations,ns,unit
+//
+// where ns is nanoseconds per unit (a sample frame, a call, or a transform).
+// Pass --json for a JSON array of the same records instead.
+//
+// Usage:
+//
+//     MinimBench [--json] [--seconds s] [--repeat n] [--block frames] [file.wav|file.mp3 ...]
+//
+// The library doesn't need a device to run any of this, so it builds anywhere the
+// sources do, as long as AudioSystem.cpp, which needs a platform ServiceProvider, is left out.
+// On Linux, from the root of the repository:
+//
+//     g++ -std=c++11 -O2 -DPOSIX -Isrc -Isrc/interfaces -Isrc/ugens -o MinimBench benchmarks/MinimBench.cpp
+//         src/AudioFormat.cpp src/AudioOutput.cpp src/AudioRecorder.cpp src/AudioSource.cpp
+//         src/FFT.cpp src/FourierTransform.cpp src/Logging.cpp src/MixKernels.cpp
+//         src/MultiChannelBuffer.cpp src/NoteManager.cpp src/NullAudioOut.cpp
+//         src/OfflineAudioOut.cpp src/RenderThreadPool.cpp src/WindowFunction.cpp
+//         src/ugens/*.cpp -lpthread
+//
+// (all on one line). To include the file read loops, install the libsndfile and libmpg123
+// development packages (the headers under libsndfile/ and mpg123/ are for Windows) and add
+//
+//     -DMINIM_BENCH_FILES -Isrc/win src/win/libsndAudioRecordingStream.cpp
+//         src/win/mpg123AudioRecordingStream.cpp -lsndfile -lmpg123
+/////////////////////////////////////////////////////////////////////
+
+#include "AudioOutput.h"
+#include "OfflineAudioOut.h"
+#include "MultiChannelBuffer.h"
+#include "FFT.h"
+
+#include "ADSR.h"
+#include "BitCrush.h"
+#include "Constant.h"
+#include "Delay.h"
+#include "Flanger.h"
+#include "Line.h"
+#include "MoogFilter.h"
+#include "Multiplier.h"
+#include "Noise.h"
+#include "Oscil.h"
+#include "Pan.h"
+#include "Sampler.h"
+#include "Summer.h"
+#include "Waveshaper.h"
+#include "Waves.h"
+#include "Wavetable.h"
+
+#ifdef MINIM_BENCH_FILES
+#include "libsndAudioRecordingStream.h"
+#include "mpg123AudioRecordingStream.h"
+#include "mpg123.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Minim;
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const float kSampleRate = 44100.f;
+
+	struct Settings
+	{
+		Settings()
+		: json( false )
+		, seconds( 2.f )
+		, repeat( 5 )
+		, blockSize( 512 )
+		{
+		}
+
+		bool						json;
+		float						seconds;
+		int							repeat;
+		int							blockSize;
+		std::vector<std::string>	files;
+	};
+
+	struct Result
+	{
+		std::string group;
+		std::string name;
+		long		size;
+		long		iterations;
+		double		ns;
+		const char*	unit;
+	};
+
+	std::vector<Result> gResults;
+
+	void report( const char * group, const std::string & name, const long size, const long iterations, const double ns, const char * unit )
+	{
+		Result r;
+		r.group = group;
+		r.name = name;
+		r.size = size;
+		r.iterations = iterations;
+		r.ns = ns;
+		r.unit = unit;
+		gResults.push_back( r );
+
+		// progress goes to stderr so stdout stays machine-readable
+		fprintf( stderr, "%-10s %-28s %8ld %12.3f ns/%s\n", group, name.c_str(), size, ns, unit );
+	}
+
+	// keep the optimizer from throwing away results we never look at
+	volatile float gSink = 0;
+
+	/////////////////////////////////////////////////////////////////////
+	// UGens
+	//
+	// Each UGen is patched alone to a mono AudioOutput driven by an OfflineAudioOut,
+	// so the numbers include the per-block overhead of the output and its schedule,
+	// which is measured on its own by the empty Summer row.
+	// Effects are fed by a Constant so that their own cost dominates.
+	/////////////////////////////////////////////////////////////////////
+
+	typedef UGen* (*UGenFactory)( std::vector<UGen*> & keep );
+
+	UGen* makeNothing( std::vector<UGen*> & keep ) { return NULL; }
+
+	UGen* makeConstant( std::vector<UGen*> & keep ) { return new Constant( 0.5f ); }
+
+	UGen* makeOscilSine( std::vector<UGen*> & keep ) { return new Oscil( 440.f, 0.5f, Waves::SINE() ); }
+
+	UGen* makeOscilSaw( std::vector<UGen*> & keep ) { return new Oscil( 440.f, 0.5f, Waves::SAW() ); }
+
+	UGen* makeOscilModulated( std::vector<UGen*> & keep )
+	{
+		Oscil* lfo = new Oscil( 2.f, 20.f, Waves::SINE() );
+		lfo->offset.setLastValue( 440.f );
+		keep.push_back( lfo );
+		Oscil* osc = new Oscil( 440.f, 0.5f, Waves::SINE() );
+		lfo->patch( osc->frequency );
+		return osc;
+	}
+
+	UGen* makeNoiseWhite( std::vector<UGen*> & keep ) { return new Noise( 0.5f, Noise::eTintWhite ); }
+
+	UGen* makeNoisePink( std::vector<UGen*> & keep ) { return new Noise( 0.5f, Noise::eTintPink ); }
+
+	UGen* makeNoiseRed( std::vector<UGen*> & keep ) { return new Noise( 0.5f, Noise::eTintRed ); }
+
+	UGen* makeLine( std::vector<UGen*> & keep )
+	{
+		Line* line = new Line( 1000.f, 0.f, 1.f );
+		line->activate();
+		return line;
+	}
+
+	UGen* makeADSR( std::vector<UGen*> & keep )
+	{
+		Constant* source = new Constant( 0.5f );
+		keep.push_back( source );
+		// a very long attack keeps the envelope in its busiest state for the whole run
+		ADSR* adsr = new ADSR( 1.f, 1000.f, 1.f, 0.5f, 1.f );
+		source->patch( *adsr );
+		adsr->noteOn();
+		return adsr;
+	}
+
+	template<typename T>
+	T* withConstantSource( T* effect, std::vector<UGen*> & keep )
+	{
+		Constant* source = new Constant( 0.5f );
+		keep.push_back( source );
+		source->patch( *effect );
+		return effect;
+	}
+
+	UGen* makeMultiplier( std::vector<UGen*> & keep ) { return withConstantSource( new Multiplier( 0.5f ), keep ); }
+
+	UGen* makeMoogLP( std::vector<UGen*> & keep ) { return withConstantSource( new MoogFilter( 1000.f, 0.5f, MoogFilter::LP ), keep ); }
+
+	UGen* makeMoogBP( std::vector<UGen*> & keep ) { return withConstantSource( new MoogFilter( 1000.f, 0.5f, MoogFilter::BP ), keep ); }
+
+	UGen* makeDelay( std::vector<UGen*> & keep ) { return withConstantSource( new Delay( 0.25f, 0.5f, true ), keep ); }
+
+	UGen* makeFlanger( std::vector<UGen*> & keep ) { return withConstantSource( new Flanger( 1.f, 0.5f, 1.f, 0.5f, 0.5f, 0.5f ), keep ); }
+
+	UGen* makeBitCrush( std::vector<UGen*> & keep ) { return withConstantSource( new BitCrush( 8.f, 11025.f ), keep ); }
+
+	UGen* makeWaveShaper( std::vector<UGen*> & keep ) { return withConstantSource( new WaveShaper( 0.5f, 1.f, Waves::SINE() ), keep ); }
+
+	UGen* makePan( std::vector<UGen*> & keep ) { return withConstantSource( new Pan( 0.25f ), keep ); }
+
+	UGen* makeSampler( std::vector<UGen*> & keep )
+	{
+		// long enough that the one trigger plays for the whole run
+		MultiChannelBuffer sample( 1, (int)(kSampleRate * 60) );
+		float * samples = sample.getChannel( 0 );
+		for ( int i = 0; i < sample.getBufferSize(); ++i )
+		{
+			samples[i] = (float)rand() / RAND_MAX * 2.f - 1.f;
+		}
+		Sampler* sampler = new Sampler( sample, 4 );
+		sampler->trigger();
+		return sampler;
+	}
+
+	struct UGenBenchmark
+	{
+		const char*	name;
+		int			channels;
+		UGenFactory	make;
+	};
+
+	const UGenBenchmark kUGenBenchmarks[] =
+	{
+		{ "Summer (empty)",		1, makeNothing },
+		{ "Constant",			1, makeConstant },
+		{ "Oscil sine",			1, makeOscilSine },
+		{ "Oscil saw",			1, makeOscilSaw },
+		{ "Oscil fm",			1, makeOscilModulated },
+		{ "Noise white",		1, makeNoiseWhite },
+		{ "Noise pink",			1, makeNoisePink },
+		{ "Noise red",			1, makeNoiseRed },
+		{ "Line",				1, makeLine },
+		{ "ADSR",				1, makeADSR },
+		{ "Multiplier",			1, makeMultiplier },
+		{ "MoogFilter LP",		1, makeMoogLP },
+		{ "MoogFilter BP",		1, makeMoogBP },
+		{ "Delay",				1, makeDelay },
+		{ "Flanger",			1, makeFlanger },
+		{ "BitCrush",			1, makeBitCrush },
+		{ "WaveShaper",			1, makeWaveShaper },
+		{ "Sampler",			1, makeSampler },
+		{ "Pan",				2, makePan },
+	};
+
+	void benchmarkUGen( const UGenBenchmark & bench, const Settings & settings )
+	{
+		OfflineAudioOut * offline = new OfflineAudioOut( AudioFormat( kSampleRate, bench.channels ), settings.blockSize );
+		// out deletes offline
+		AudioOutput out( offline );
+
+		std::vector<UGen*> keep;
+		UGen * ugen = bench.make( keep );
+		if ( ugen )
+		{
+			ugen->patch( out );
+		}
+
+		const long frames = (long)(settings.seconds * kSampleRate);
+
+		// warm up caches and let anything lazily allocated get allocated
+		offline->render( settings.blockSize * 8 );
+
+		double best = 0;
+		for ( int r = 0; r < settings.repeat; ++r )
+		{
+			Clock::time_point start = Clock::now();
+			offline->render( frames );
+			const double ns = std::chrono::duration<double, std::nano>( Clock::now() - start ).count();
+			if ( r == 0 || ns < best )
+			{
+				best = ns;
+			}
+		}
+
+		gSink = gSink + offline->getOutputBuffer().getSample( 0, 0 );
+
+		report( "ugen", bench.name, settings.blockSize, frames, best / frames, "frame" );
+
+		if ( ugen )
+		{
+			ugen->unpatch( out );
+			delete ugen;
+		}
+		for ( size_t i = 0; i < keep.size(); ++i )
+		{
+			delete keep[i];
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////
+	// FFT
+	/////////////////////////////////////////////////////////////////////
+
+	void benchmarkFFT( const Settings & settings )
+	{
+		for ( int size = 32; size <= 65536; size *= 2 )
+		{
+			FFT fft( size, kSampleRate );
+			std::vector<float> buffer( size );
+			for ( int i = 0; i < size; ++i )
+			{
+				buffer[i] = (float)rand() / RAND_MAX * 2.f - 1.f;
+			}
+
+			// roughly the same amount of work at every size
+			const long calls = std::max( 8L, (long)(settings.seconds * kSampleRate * 4) / size );
+
+			double bestForward = 0;
+			double bestInverse = 0;
+			for ( int r = 0; r < settings.repeat; ++r )
+			{
+				Clock::time_point start = Clock::now();
+				for ( long c = 0; c < calls; ++c )
+				{
+					fft.forward( &buffer[0] );
+				}
+				const double forward = std::chrono::duration<double, std::nano>( Clock::now() - start ).count();
+
+				start = Clock::now();
+				for ( long c = 0; c < calls; ++c )
+				{
+					fft.inverse( &buffer[0] );
+				}
+				const double inverse = std::chrono::duration<double, std::nano>( Clock::now() - start ).count();
+
+				if ( r == 0 || forward < bestForward ) bestForward = forward;
+				if ( r == 0 || inverse < bestInverse ) bestInverse = inverse;
+			}
+
+			gSink = gSink + buffer[0] + fft.getBand( 1 );
+
+			report( "fft", "forward", size, calls, bestForward / calls, "transform" );
+			report( "fft", "inverse", size, calls, bestInverse / calls, "transform" );
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////
+	// Wavetable
+	/////////////////////////////////////////////////////////////////////
+
+	void benchmarkWavetable( const Settings & settings )
+	{
+		// lookups that step through the table like an Oscil would, and ones that jump around
+		const int kLookups = 4096;
+		std::vector<float> stepped( kLookups );
+		std::vector<float> random( kLookups );
+		for ( int i = 0; i < kLookups; ++i )
+		{
+			stepped[i] = (float)i / kLookups;
+			random[i] = (float)rand() / RAND_MAX;
+		}
+
+		struct Lookup
+		{
+			const char*					name;
+			const std::vector<float> *	at;
+		};
+		const Lookup lookups[] = { { "value stepped", &stepped }, { "value random", &random } };
+
+		const int sizes[] = { 512, 4096, 65536 };
+		for ( size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s )
+		{
+			Wavetable table( sizes[s] );
+			for ( int i = 0; i < sizes[s]; ++i )
+			{
+				table.set( i, sinf( (float)i / sizes[s] * 6.2831853f ) );
+			}
+
+			for ( size_t l = 0; l < sizeof(lookups) / sizeof(lookups[0]); ++l )
+			{
+				const float * at = &(*lookups[l].at)[0];
+				const long passes = std::max( 1L, (long)(settings.seconds * kSampleRate) / kLookups );
+
+				double best = 0;
+				for ( int r = 0; r < settings.repeat; ++r )
+				{
+					float sum = 0;
+					Clock::time_point start = Clock::now();
+					for ( long p = 0; p < passes; ++p )
+					{
+						for ( int i = 0; i < kLookups; ++i )
+						{
+							sum += table.value( at[i] );
+						}
+					}
+					const double ns = std::chrono::duration<double, std::nano>( Clock::now() - start ).count();
+					gSink = gSink + sum;
+					if ( r == 0 || ns < best ) best = ns;
+				}
+
+				report( "wavetable", lookups[l].name, sizes[s], passes * kLookups, best / (passes * kLookups), "call" );
+			}
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////
+	// MultiChannelBuffer
+	/////////////////////////////////////////////////////////////////////
+
+	void benchmarkBufferCopies( const Settings & settings )
+	{
+		const int sizes[] = { 256, 1024, 8192 };
+		for ( size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s )
+		{
+			MultiChannelBuffer source( 2, sizes[s] );
+			MultiChannelBuffer dest( 2, sizes[s] );
+			for ( int i = 0; i < sizes[s]; ++i )
+			{
+				source.getChannel( 0 )[i] = (float)i;
+				source.getChannel( 1 )[i] = (float)-i;
+			}
+
+			const long copies = std::max( 8L, (long)(settings.seconds * kSampleRate) / sizes[s] );
+
+			double bestAssign = 0;
+			double bestChannel = 0;
+			for ( int r = 0; r < settings.repeat; ++r )
+			{
+				Clock::time_point start = Clock::now();
+				for ( long c = 0; c < copies; ++c )
+				{
+					dest = source;
+				}
+				const double assign = std::chrono::duration<double, std::nano>( Clock::now() - start ).count();
+
+				start = Clock::now();
+				for ( long c = 0; c < copies; ++c )
+				{
+					// the way OfflineAudioOut copies blocks out
+					memcpy( dest.getChannel( 0 ), source.getChannel( 1 ), sizes[s] * sizeof(float) );
+					memcpy( dest.getChannel( 1 ), source.getChannel( 0 ), sizes[s] * sizeof(float) );
+				}
+				const double channel = std::chrono::duration<double, std::nano>( Clock::now() - start ).count();
+
+				if ( r == 0 || assign < bestAssign ) bestAssign = assign;
+				if ( r == 0 || channel < bestChannel ) bestChannel = channel;
+			}
+
+			gSink = gSink + dest.getSample( 1, sizes[s] - 1 );
+
+			report( "buffer", "operator=", sizes[s], copies * sizes[s], bestAssign / (copies * sizes[s]), "frame" );
+			report( "buffer", "memcpy", sizes[s], copies * sizes[s], bestChannel / (copies * sizes[s]), "frame" );
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////
+	// File read loops
+	/////////////////////////////////////////////////////////////////////
+
+#ifdef MINIM_BENCH_FILES
+	bool endsWith( const std::string & str, const char * suffix )
+	{
+		const size_t len = strlen( suffix );
+		if ( str.size() < len )
+		{
+			return false;
+		}
+		for ( size_t i = 0; i < len; ++i )
+		{
+			if ( tolower( str[str.size() - len + i] ) != suffix[i] )
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void benchmarkFile( const std::string & path, const Settings & settings )
+	{
+		const bool bMp3 = endsWith( path, ".mp3" );
+		const int kBufferSize = 1024;
+
+		double best = 0;
+		long frames = 0;
+		for ( int r = 0; r < settings.repeat; ++r )
+		{
+			AudioRecordingStream * stream = NULL;
+			if ( bMp3 )
+			{
+				stream = new mpg123AudioRecordingStream( path.c_str(), kBufferSize );
+			}
+			else
+			{
+				stream = new libsndAudioRecordingStream( path.c_str(), kBufferSize );
+			}
+
+			stream->open();
+			MultiChannelBuffer buffer( stream->getFormat().getChannels(), kBufferSize );
+
+			long read = 0;
+			Clock::time_point start = Clock::now();
+			stream->play();
+			while ( stream->isPlaying() )
+			{
+				stream->read( buffer );
+				read += kBufferSize;
+			}
+			const double ns = std::chrono::duration<double, std::nano>( Clock::now() - start ).count();
+
+			gSink = gSink + buffer.getSample( 0, 0 );
+
+			stream->close();
+			delete stream;
+
+			if ( read == 0 )
+			{
+				fprintf( stderr, "Couldn't read anything from %s.\n", path.c_str() );
+				return;
+			}
+
+			frames = read;
+			if ( r == 0 || ns < best ) best = ns;
+		}
+
+		report( bMp3 ? "mpg123" : "libsndfile", path, kBufferSize, frames, best / frames, "frame" );
+	}
+#endif // MINIM_BENCH_FILES
+
+	/////////////////////////////////////////////////////////////////////
+	// Output
+	/////////////////////////////////////////////////////////////////////
+
+	// names are file paths for the read loops, so they can contain anything
+	std::string escape( const std::string & str, const bool json )
+	{
+		std::string out;
+		for ( size_t i = 0; i < str.size(); ++i )
+		{
+			if ( str[i] == '"' || ( json && str[i] == '\\' ) )
+			{
+				out += json ? '\\' : '"';
+			}
+			out += str[i];
+		}
+		return out;
+	}
+
+	void printResults( const Settings & settings )
+	{
+		if ( settings.json )
+		{
+			printf( "[\n" );
+			for ( size_t i = 0; i < gResults.size(); ++i )
+			{
+				const Result & r = gResults[i];
+				printf( "  { \"group\": \"%s\", \"name\": \"%s\", \"size\": %ld, \"iterations\": %ld, \"ns\": %.4f, \"unit\": \"%s\" }%s\n",
+						r.group.c_str(), escape( r.name, true ).c_str(), r.size, r.iterations, r.ns, r.unit,
+						i + 1 < gResults.size() ? "," : "" );
+			}
+			printf( "]\n" );
+		}
+		else
+		{
+			printf( "group,name,size,iterations,ns,unit\n" );
+			for ( size_t i = 0; i < gResults.size(); ++i )
+			{
+				const Result & r = gResults[i];
+				printf( "%s,\"%s\",%ld,%ld,%.4f,%s\n", r.group.c_str(), escape( r.name, false ).c_str(), r.size, r.iterations, r.ns, r.unit );
+			}
+		}
+	}
+
+	void usage()
+	{
+		fprintf( stderr, "usage: MinimBench [--json] [--seconds s] [--repeat n] [--block frames] [file.wav|file.mp3 ...]\n" );
+	}
+}
+
+int main( int argc, char ** argv )
+{
+	Settings settings;
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		const std::string arg( argv[i] );
+		if ( arg == "--json" )
+		{
+			settings.json = true;
+		}
+		else if ( arg == "--seconds" && i + 1 < argc )
+		{
+			settings.seconds = (float)atof( argv[++i] );
+		}
+		else if ( arg == "--repeat" && i + 1 < argc )
+		{
+			settings.repeat = atoi( argv[++i] );
+		}
+		else if ( arg == "--block" && i + 1 < argc )
+		{
+			settings.blockSize = atoi( argv[++i] );
+		}
+		else if ( arg == "--help" || arg[0] == '-' )
+		{
+			usage();
+			return arg == "--help" ? 0 : 1;
+		}
+		else
+		{
+			settings.files.push_back( arg );
+		}
+	}
+
+	if ( settings.seconds <= 0 || settings.repeat <= 0 || settings.blockSize <= 0 )
+	{
+		usage();
+		return 1;
+	}
+
+	srand( 1 );
+
+	for ( size_t i = 0; i < sizeof(kUGenBenchmarks) / sizeof(kUGenBenchmarks[0]); ++i )
+	{
+		benchmarkUGen( kUGenBenchmarks[i], settings );
+	}
+
+	benchmarkFFT( settings );
+	benchmarkWavetable( settings );
+	benchmarkBufferCopies( settings );
+
+#ifdef MINIM_BENCH_FILES
+	mpg123_init();
+	for ( size_t i = 0; i < settings.files.size(); ++i )
+	{
+		benchmarkFile( settings.files[i], settings );
+	}
+	mpg123_exit();
+#else
+	if ( !settings.files.empty() )
+	{
+		fprintf( stderr, "Built without MINIM_BENCH_FILES, so file arguments are ignored.\n" );
+	}
+#endif
+
+	printResults( settings );
+
+	return 0;
+}
@@ -1,6 +1,6 @@
 #include "AudioFormat.h"
 
-#ifdef WINDOWS
+#if defined(WINDOWS) || defined(__linux__)
 
 Minim::AudioFormat::AudioFormat( float sampleRate, int numberOfChannels )
 : mChannels(numberOfChannels)
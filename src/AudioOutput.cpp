@@ -19,7 +19,10 @@
 #include "AudioOutput.h"
 #include "AudioStream.h"
 #include "AudioFormat.h"
-//#include "CodeTimer.h"
+#include "MixKernels.h"
+
+#include <algorithm>
+#include <chrono>
 
 namespace Minim
 {
@@ -28,13 +31,70 @@ namespace Minim
 	: AudioSource(out)
 	, mSummer()
 	, mNoteManager( *this )
-	, mSummerStream(mSummer, mNoteManager, out->getFormat(), buffer().getBufferSize())
+	, mSummerStream(*this, mSummer, mNoteManager, out->getFormat(), buffer().getBufferSize())
+	, mRenderThreadCount(0)
+	, mRenderThreadPriority(0)
+	, mCommands(kCommandQueueSize)
+	, mCommandOrder(0)
+	, mFrameCount(0)
+	, mRetired(kCommandQueueSize)
+	, mHousekeeping(true)
 	{
+		// so that waiting doesn't allocate on the audio thread, neither one grows past this
+		mWaitingToDelete.reserve( kCommandQueueSize );
+		mTimedCommands.reserve( kCommandQueueSize );
+		
 		out->setAudioStream( &mSummerStream );
 		out->open();
 		
 		mSummer.setSampleRate( getFormat().getSampleRate() );
 		mSummer.setAudioChannelCount( getFormat().getChannels() );
+		
+		// patching swaps out the input lists of Summers, which the audio thread leaves for us to free
+		mHousekeeper = std::thread( &AudioOutput::housekeeperLoop, this );
+	}
+	
+	AudioOutput::~AudioOutput()
+	{
+		// stop the output before our stream goes away, 
+		// outputs with their own thread would otherwise keep reading from it.
+		close();
+		delete mSummerStream.setThreadPool( NULL );
+		
+		if ( mHousekeeper.joinable() )
+		{
+			mHousekeeping = false;
+			mHousekeeper.join();
+		}
+		
+		// nothing is rendering anymore, so whatever is left can go right away
+		Command command;
+		while ( mCommands.pop( command ) )
+		{
+			if ( command.type == Command::eDelete )
+			{
+				command.function( command.target );
+			}
+		}
+		for( size_t i = 0; i < mWaitingToDelete.size(); ++i )
+		{
+			mWaitingToDelete[i].function( mWaitingToDelete[i].target );
+		}
+		while ( mRetired.pop( command ) )
+		{
+			command.function( command.target );
+		}
+	}
+	
+	void AudioOutput::setRenderThreadCount( const int numThreads, const int priority )
+	{
+		if ( numThreads != mRenderThreadCount || priority != mRenderThreadPriority )
+		{
+			RenderThreadPool * pool = numThreads > 0 ? new RenderThreadPool( numThreads, priority ) : NULL;
+			delete mSummerStream.setThreadPool( pool );
+			mRenderThreadCount = numThreads > 0 ? numThreads : 0;
+			mRenderThreadPriority = priority;
+		}
 	}
 	
 	void AudioOutput::pauseNotes()
@@ -52,43 +112,230 @@ namespace Minim
 		mNoteManager.addEvent(startTime, duration, instrument);
 	}
 	
-	AudioOutput::SummerStream::SummerStream( Summer & summer, NoteManager & noteManager, const AudioFormat & format, const int bufferSize )
-		: mSummer(summer)
+	bool AudioOutput::postPatch( UGen & from, UGen & to, const float delay )
+	{
+		return post( Command::ePatchUGen, &from, &to, 0, delay );
+	}
+	
+	bool AudioOutput::postPatch( UGen & from, UGen::UGenInput & to, const float delay )
+	{
+		return post( Command::ePatchInput, &from, &to, 0, delay );
+	}
+	
+	bool AudioOutput::postPatch( UGen & ugen, const float delay )
+	{
+		return post( Command::ePatchOutput, &ugen, NULL, 0, delay );
+	}
+	
+	bool AudioOutput::postUnpatch( UGen & from, UGen & to, const float delay )
+	{
+		return post( Command::eUnpatchUGen, &from, &to, 0, delay );
+	}
+	
+	bool AudioOutput::postUnpatch( UGen & ugen, const float delay )
+	{
+		return post( Command::eUnpatchOutput, &ugen, NULL, 0, delay );
+	}
+	
+	bool AudioOutput::postSetValue( UGen::UGenInput & input, const float value, const float delay )
+	{
+		return post( Command::eSetValue, NULL, &input, value, delay );
+	}
+	
+	bool AudioOutput::postCall( CommandFunction function, void * userData, const float delay )
+	{
+		return post( Command::eCall, NULL, userData, 0, delay, function );
+	}
+	
+	bool AudioOutput::post( const Command::Type type, UGen * ugen, void * target, const float value, const float delay, CommandFunction function )
+	{
+		Command command;
+		command.type	 = type;
+		command.ugen	 = ugen;
+		command.target	 = target;
+		command.value	 = value;
+		command.function = function;
+		command.frame	 = mFrameCount + ( delay > 0 ? (long long)( delay * sampleRate() ) : 0 );
+		command.order	 = 0;
+		
+		return mCommands.push( command );
+	}
+	
+	void AudioOutput::applyCommands()
+	{
+		const long long now = mFrameCount;
+		Command command;
+		// a command might have to wait in either of these, so once one of them is full 
+		// the rest stay in the queue until there's room again, instead of growing them here.
+		while ( mTimedCommands.size() < kCommandQueueSize && mWaitingToDelete.size() < kCommandQueueSize 
+			    && mCommands.pop( command ) )
+		{
+			if ( command.frame > now && command.type != Command::eDelete )
+			{
+				command.order = mCommandOrder++;
+				mTimedCommands.push_back( command );
+				std::push_heap( mTimedCommands.begin(), mTimedCommands.end() );
+			}
+			else
+			{
+				apply( command );
+			}
+		}
+		
+		// UGens that unpatch themselves, like an ADSR, do it while generating,
+		// so they are safe to delete after the block they did it in.
+		// stop at the first one that is still patched, or if the housekeeper is full.
+		size_t retired = 0;
+		while ( retired < mWaitingToDelete.size() )
+		{
+			const Command & waiter = mWaitingToDelete[retired];
+			if ( ( waiter.ugen && mSummer.hasInput( waiter.ugen ) ) || !mRetired.push( waiter ) )
+			{
+				break;
+			}
+			++retired;
+		}
+		if ( retired > 0 )
+		{
+			mWaitingToDelete.erase( mWaitingToDelete.begin(), mWaitingToDelete.begin() + retired );
+		}
+	}
+	
+	int AudioOutput::applyTimedCommands( const int maxFrames )
+	{
+		const long long now = mFrameCount;
+		while ( !mTimedCommands.empty() && mTimedCommands.front().frame <= now )
+		{
+			std::pop_heap( mTimedCommands.begin(), mTimedCommands.end() );
+			const Command command = mTimedCommands.back();
+			mTimedCommands.pop_back();
+			
+			apply( command );
+		}
+		
+		if ( !mTimedCommands.empty() && mTimedCommands.front().frame - now < maxFrames )
+		{
+			return (int)( mTimedCommands.front().frame - now );
+		}
+		return maxFrames;
+	}
+	
+	void AudioOutput::apply( const Command & command )
+	{
+		switch( command.type )
+		{
+			case Command::ePatchUGen:
+				command.ugen->patch( *static_cast<UGen*>(command.target) );
+				break;
+			case Command::ePatchInput:
+				command.ugen->patch( *static_cast<UGen::UGenInput*>(command.target) );
+				break;
+			case Command::ePatchOutput:
+				command.ugen->patch( *this );
+				break;
+			case Command::eUnpatchUGen:
+				command.ugen->unpatch( *static_cast<UGen*>(command.target) );
+				break;
+			case Command::eUnpatchOutput:
+				command.ugen->unpatch( *this );
+				break;
+			case Command::eSetValue:
+				static_cast<UGen::UGenInput*>(command.target)->setLastValue( command.value );
+				break;
+			case Command::eCall:
+				command.function( command.target );
+				break;
+			case Command::eDelete:
+				// everything posted before this has been applied and any block that could 
+				// have been using it has finished, but deletes stay in order.
+				mWaitingToDelete.push_back( command );
+				break;
+		}
+	}
+	
+	void AudioOutput::housekeeperLoop()
+	{
+		Command command;
+		while ( mHousekeeping )
+		{
+			while ( mRetired.pop( command ) )
+			{
+				command.function( command.target );
+			}
+			
+			Summer::reclaim();
+			
+			std::this_thread::sleep_for( std::chrono::milliseconds(10) );
+		}
+	}
+	
+	AudioOutput::SummerStream::SummerStream( AudioOutput & output, Summer & summer, NoteManager & noteManager, const AudioFormat & format, const int bufferSize )
+		: mOutput(output)
+		, mSummer(summer)
+		, mSchedule(summer)
 		, mNoteManager(noteManager)
 		, mFormat(format)
 		, mVolume(1.f)
 		, mTargetVolume(1.f)
+		, mLoad(0)
+		, mPeakLoad(0)
 	{
-		mTickBuffer = new float[format.getChannels()];
         mBufferMicrosecondLength = (float)bufferSize / format.getSampleRate() * 1000000;
 	}
 
 	AudioOutput::SummerStream::~SummerStream()
 	{
-		delete [] mTickBuffer;
 	}
 
 	void AudioOutput::SummerStream::read( MultiChannelBuffer & buffer )
 	{
-		// CodeTimer timer("Buffer underrun in AudioOutput: ", mBufferMicrosecondLength );
+		typedef std::chrono::steady_clock Clock;
+		const Clock::time_point start = Clock::now();
+		
+		// everything posted from other threads goes in before we generate anything
+		mOutput.applyCommands();
 		
 		const int nChannels = buffer.getChannelCount();
 		const int bsize = buffer.getBufferSize();
-		for(int i = 0; i < bsize; ++i)
+		// ramp every channel to the same place, even if the volume is set while we generate
+		const float targetVolume = mTargetVolume;
+		int frame = 0;
+		while( frame < bsize )
+		{
+			// timed commands and the note manager tell us how many frames we can generate
+			// before the next command needs to be applied or note event needs to be sent.
+			const int maxFrames = mOutput.applyTimedCommands( bsize - frame );
+			const int nFrames = mNoteManager.tick( maxFrames );
+			
+			mSchedule.render( nFrames );
+			mOutput.mFrameCount.store( mOutput.mFrameCount.load() + nFrames );
+			
+			float * const * summed = mSummer.getBlockValues();
+			for(int c = 0; c < nChannels; ++c)
+			{
+				MixKernels::ramp( buffer.getChannel(c) + frame, summed[c], mVolume, targetVolume, frame, bsize, nFrames );
+			}
+			
+			frame += nFrames;
+		}
+		mVolume = targetVolume;
+		
+		// the deadline is how long this buffer is, which isn't always the size we asked for when
+		// we were made. devices can open with another size and offline outputs end on a partial block.
+		const float bufferSeconds = mFormat.getSampleRate() > 0 ? bsize / mFormat.getSampleRate() : 0;
+		if ( bufferSeconds > 0 )
 		{
-            mNoteManager.tick();
-    
-            // don't need to memset our tick buffer
-            // because the summer will assign for the first ugen it ticks
-            // and then sum after that.
-            mSummer.uGenerate( mTickBuffer, nChannels );
-            for(int c = 0; c < nChannels; ++c)
-            {
-                float v = mVolume + (mTargetVolume - mVolume)*((float)i/bsize);
-                buffer.getChannel(c)[i] = mTickBuffer[c] * v;
-            }
+			const float micros = std::chrono::duration<float, std::micro>( Clock::now() - start ).count();
+			const float load = micros / ( bufferSeconds * 1000000 );
+			
+			// one second's worth of buffers makes up most of the average load
+			const float smoothing = std::min( 1.f, bufferSeconds );
+			mLoad.store( mLoad.load() + ( load - mLoad.load() ) * smoothing );
+			if ( load > mPeakLoad.load() )
+			{
+				mPeakLoad.store( load );
+			}
 		}
-		mVolume = mTargetVolume;
 	}
 
 
@@ -21,8 +21,14 @@
 
 #include "AudioSource.h"
 #include "Summer.h"
+#include "UGenSchedule.h"
 #include "AudioStream.h"
 #include "NoteManager.h"
+#include "LockFreeQueue.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
 
 
 namespace Minim
@@ -33,6 +39,7 @@ namespace Minim
 	{
 	public:
 		AudioOutput( AudioOut * out );
+		virtual ~AudioOutput();
 		
 		void pauseNotes();
 		void resumeNotes();
@@ -44,19 +51,144 @@ namespace Minim
         
         inline void setTempo( const float tempo ) { mNoteManager.setTempo( tempo ); }
         inline float getTempo() const { return mNoteManager.getTempo(); }
+		
+		// Render the UGens patched to this output on numThreads worker threads in addition to 
+		// the audio thread. Each UGen patched directly to the output, along with everything 
+		// that only it depends on, is rendered as one task. The mix is summed in the same order 
+		// as it is with one thread, so the output doesn't change (see UGenSchedule for caveats).
+		// Pass 0 to go back to rendering everything on the audio thread, which is the default.
+		// priority is what the render threads are scheduled at (see RenderThreadPool) and should
+		// be no higher than the audio thread's, e.g. the priority given to LinuxServiceProvider.
+		void setRenderThreadCount( const int numThreads, const int priority = 0 );
+		inline int getRenderThreadCount() const { return mRenderThreadCount; }
+		
+		// Time every UGen patched to this output while it generates audio, 
+		// so you can see which ones are expensive with UGen::getProfile. Off by default.
+		inline void setProfiling( const bool profile ) { mSummerStream.setProfiling( profile ); }
+		inline bool isProfiling() const { return mSummerStream.isProfiling(); }
+		
+		// How long generating a buffer takes compared to how long the buffer is,
+		// averaged over about the last second. At 1 the audio thread is only just keeping up.
+		// This is always measured, it doesn't need profiling turned on.
+		// Like the rest of the load methods, it is safe to call from any thread.
+		inline float getDspLoad() const { return mSummerStream.getLoad(); }
+		// the highest load of any one buffer since this was last reset.
+		inline float getPeakDspLoad() const { return mSummerStream.getPeakLoad(); }
+		inline void  resetPeakDspLoad() { mSummerStream.resetPeakLoad(); }
+		
+		// Patching and setting values directly from another thread while the audio thread is 
+		// generating a block can leave the graph half changed for that block. Posting them 
+		// instead queues them up without blocking, and the audio thread applies everything 
+		// in the queue, in order, before it generates the next buffer. The post methods can 
+		// be called from any number of threads, and return false if the queue is full 
+		// (the audio thread isn't running, or more than kCommandQueueSize are waiting).
+		// The audio thread also stops taking commands out of the queue while kCommandQueueSize 
+		// timed commands are waiting for their frame, or kCommandQueueSize deletes are waiting 
+		// on their UGens, so once that backlog is full the post methods return false too.
+		// What is passed in has to stay alive until the command has been applied.
+		//
+		// Give a delay, in seconds from now, to have a command applied on an exact sample frame 
+		// instead. The buffer is split at that frame, like it is for notes, so the change 
+		// lands where it should while the rest of the buffer is still rendered in big blocks.
+		// Now is the sample frame the output has generated up to when the command is posted. 
+		// The buffer is generated in sub-blocks that end wherever a note event or timed command 
+		// lands, and that count goes up after each one, so now is the start of the sub-block 
+		// being generated (or the next one), not the start of the buffer. Posting from a note's 
+		// noteOn or from a posted call puts now on the frame that note or call happened on.
+		// Anything a timed command refers to must not be passed to deleteLater until after 
+		// the command has been applied.
+		bool postPatch( UGen & from, UGen & to, const float delay = 0 );
+		bool postPatch( UGen & from, UGen::UGenInput & to, const float delay = 0 );
+		// patches to this output
+		bool postPatch( UGen & ugen, const float delay = 0 );
+		bool postUnpatch( UGen & from, UGen & to, const float delay = 0 );
+		// unpatches from this output
+		bool postUnpatch( UGen & ugen, const float delay = 0 );
+		bool postSetValue( UGen::UGenInput & input, const float value, const float delay = 0 );
+		
+		// for anything else, like triggering a Sampler, post a function 
+		// to be called on the audio thread with userData.
+		typedef void (*CommandFunction)( void * userData );
+		bool postCall( CommandFunction function, void * userData, const float delay = 0 );
+		
+		static const int kCommandQueueSize = 1024;
+		
+		// Delete object on a housekeeping thread once the audio thread can no longer be using it,
+		// which is after it is done with the buffer it was generating when this was called.
+		// Deletes happen in the order they were asked for, after everything posted before them
+		// has been applied, so unpatch object first, either directly or by posting it.
+		//
+		// If waitFor (object itself, if it's a UGen) is patched to this output, object isn't deleted
+		// until it isn't, and neither is anything asked for after it. So you can hand over an 
+		// instrument whose ADSR will unpatch itself from the output after its release, by passing 
+		// the ADSR as waitFor, or the ADSR and then the UGens patched to it, in that order.
+		// waitFor has to stay alive until object is deleted, being part of object is fine.
+		// Returns false if the queue is full.
+		template<typename T>
+		bool deleteLater( T * object )
+		{
+			return post( Command::eDelete, asUGen( object ), object, 0, 0, &deleteObject<T> );
+		}
+		
+		template<typename T>
+		bool deleteLater( T * object, UGen & waitFor )
+		{
+			return post( Command::eDelete, &waitFor, object, 0, 0, &deleteObject<T> );
+		}
 
 	private:
 		// UGen is our friend so that it can get to our summer
 		friend class Minim::UGen;
 		Summer mSummer;
 		
+		struct Command
+		{
+			enum Type { ePatchUGen, ePatchInput, ePatchOutput, eUnpatchUGen, eUnpatchOutput, eSetValue, eCall, eDelete };
+			
+			Type				type;
+			UGen *				ugen;
+			// the UGen or UGenInput being patched to, the userData of eCall, or what eDelete deletes
+			void *				target;
+			float				value;
+			CommandFunction		function;
+			// the sample frame to apply the command on, see mFrameCount
+			long long			frame;
+			// commands on the same frame are applied in the order they arrived
+			unsigned int		order;
+			
+			// for the heap of timed commands, which puts the next one at the front
+			inline bool operator<( const Command & other ) const
+			{
+				return frame != other.frame ? frame > other.frame : (int)(order - other.order) > 0;
+			}
+		};
+		
+		bool post( const Command::Type type, UGen * ugen, void * target, const float value = 0, const float delay = 0, CommandFunction function = NULL );
+		// called by our stream before each buffer, applies everything that isn't timed for later
+		void applyCommands();
+		// called by our stream before each block, applies the timed commands that are due
+		// and returns how many frames, up to maxFrames, can be generated before the next one.
+		int applyTimedCommands( const int maxFrames );
+		void apply( const Command & command );
+		
+		// deletes whatever the audio thread has said is safe to delete, 
+		// and the input lists Summers have swapped out, until we're destroyed
+		void housekeeperLoop();
+		
+		template<typename T>
+		static void deleteObject( void * object ) { delete static_cast<T*>( object ); }
+		
+		// so deleteLater knows if it's been given a UGen
+		static UGen * asUGen( UGen * ugen ) { return ugen; }
+		static UGen * asUGen( void * ) { return NULL; }
+		
 
 		// an adapter class that will let us plug the Summer UGen into an AudioOut
 		class SummerStream : public AudioStream
 		{
 		public:
 			
-			SummerStream( Summer & summer, NoteManager & noteManager, const AudioFormat & format, const int bufferSize );
+			SummerStream( AudioOutput & output, Summer & summer, NoteManager & noteManager, const AudioFormat & format, const int bufferSize );
 			~SummerStream();
 
 			// AudioResource impl
@@ -69,19 +201,50 @@ namespace Minim
 			void  setVolume( const float volume ) { mTargetVolume = volume; }
 			float getVolume() const { return mTargetVolume; }
 			
+			RenderThreadPool * setThreadPool( RenderThreadPool * pool ) { return mSchedule.setThreadPool( pool ); }
+			
+			void setProfiling( const bool profile ) { mSchedule.setProfiling( profile ); }
+			bool isProfiling() const { return mSchedule.isProfiling(); }
+			
+			float getLoad() const { return mLoad.load(); }
+			float getPeakLoad() const { return mPeakLoad.load(); }
+			void  resetPeakLoad() { mPeakLoad.store( 0 ); }
+			
 		private:
+			AudioOutput & mOutput;
 			Summer & mSummer;
+			// everything patched to mSummer, in the order it needs to be generated
+			UGenSchedule mSchedule;
 			const AudioFormat & mFormat;
-			float * mTickBuffer;
 			NoteManager & mNoteManager;
 			// scalar applied to samples before being written into the output buffer
 			float mVolume; // actual volume
 			float mTargetVolume; // where we are headed
-            long unsigned int mBufferMicrosecondLength; // so we can report bufferunderrun
+            long unsigned int mBufferMicrosecondLength; // the deadline for generating a buffer
+			// see AudioOutput::getDspLoad
+			std::atomic<float> mLoad;
+			std::atomic<float> mPeakLoad;
 			
 		} mSummerStream;
 		
 		NoteManager mNoteManager;
+		
+		int mRenderThreadCount;
+		int mRenderThreadPriority;
+		
+		LockFreeQueue<Command> mCommands;
+		// commands posted with a delay, ordered by when they should be applied. audio thread only.
+		std::vector<Command>	mTimedCommands;
+		unsigned int			mCommandOrder;
+		// how many sample frames we have generated, the clock timed commands go by
+		std::atomic<long long>	mFrameCount;
+		
+		// deleteLater: eDelete commands that can't be retired yet, only touched by the audio thread,
+		// and the ones that are ready to be deleted by the housekeeper.
+		std::vector<Command>	mWaitingToDelete;
+		LockFreeQueue<Command>	mRetired;
+		std::thread				mHousekeeper;
+		std::atomic<bool>		mHousekeeping;
 
 	};
 };
@@ -18,7 +18,7 @@
 
 #include "AudioSource.h"
 #include "AudioOut.h"
-#include <string> // for memset
+#include <string.h> // for memset
 
 namespace Minim
 {
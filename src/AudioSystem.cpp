@@ -23,9 +23,13 @@
 #include "AudioRecordingStream.h"
 #include "AudioOutput.h"
 #include "Logging.h"
+#include <stdio.h> // for printf
+#include <string.h> // for memcpy, strlen
 
 #ifdef WINDOWS
 #include "DirectSoundServiceProvider.h"
+#elif defined(__linux__)
+#include "LinuxServiceProvider.h"
 #else
 #include "TouchServiceProvider.h"
 #endif
@@ -54,6 +58,8 @@ AudioSystem::AudioSystem( const int outputBufferSize, AudioInterruptionListener
 {
 #ifdef WINDOWS
 	mServiceProvider = new Minim::DirectSoundServiceProvider();
+#elif defined(__linux__)
+	mServiceProvider = new Minim::LinuxServiceProvider();
 #elif TARGET_OS_IPHONE
 	TouchServiceProvider::AudioSessionParameters sessionParams( (float)outputBufferSize / 44100.f );
     sessionParams.interruptListener = &interruptionHandler;
@@ -16,15 +16,10 @@
 
 Minim::FFT::FFT(int timeSize, float sampleRate)
 : FourierTransform(timeSize,sampleRate)
-, m_reverseReal(NULL)
-, m_reverseImag(NULL)
 {
 	assert( (timeSize & (timeSize - 1))==0 && "FFT: timeSize must be a power of two." );
 	buildReverseTable();
 	buildTrigTables();
-
-	m_reverseReal = new float[m_timeSize];
-	m_reverseImag = new float[m_timeSize];
 }
 
 Minim::FFT::~FFT()
@@ -32,16 +27,6 @@ Minim::FFT::~FFT()
 	delete [] reverse;
 	delete [] sinlookup;
 	delete [] coslookup;
-
-	if ( m_reverseReal )
-	{
-		delete m_reverseReal;
-	}
-
-	if ( m_reverseImag )
-	{
-		delete m_reverseImag;
-	}
 }
 
 void Minim::FFT::scaleBand(int i, float s)
@@ -101,10 +86,23 @@ void Minim::FFT::forward( float * buffer )
 //	}
 	
 	doWindow( buffer, m_timeSize );
-	// copy samples to real/imag in bit-reversed order
-	bitReverseSamples(buffer, 0);
-	// perform the fft
-	fft();
+	
+	if ( m_timeSize < 2 )
+	{
+		// copy samples to real/imag in bit-reversed order
+		bitReverseSamples(buffer, 0);
+		// perform the fft
+		fft(m_timeSize);
+	}
+	else
+	{
+		// the even samples are the real part and the odd samples the imaginary part
+		// of a signal half as long, which we transform and then pull apart.
+		bitReverseSamplePairs(buffer);
+		fft(m_timeSize/2);
+		splitHalfSpectrum();
+	}
+	
 	// fill the spectrum buffer with amplitudes
 	fillSpectrum();
 }
@@ -119,8 +117,8 @@ void Minim::FFT::forward( const float * buffReal, const float * buffImag )
 //	}
 	
 	setComplex(buffReal, buffImag);
-	bitReverseComplex();
-	fft();
+	bitReverseComplex(m_timeSize);
+	fft(m_timeSize);
 	fillSpectrum();
 }
 
@@ -133,38 +131,132 @@ void Minim::FFT::inverse( float * buffer )
 //		return;
 //	}
 	
-	// conjugate
-	for (int i = 0; i < m_timeSize; i++)
+	if ( m_timeSize < 2 )
+	{
+		buffer[0] = m_real[0];
+		return;
+	}
+	
+	// the output is real, so only the half spectrum matters. whatever isn't
+	// symmetric in the other half would only have ended up in the imaginary part.
+	joinHalfSpectrum();
+	
+	// the inverse of a signal half as long, by way of the forward transform of its conjugate
+	const int halfSize = m_timeSize/2;
+	for (int i = 0; i < halfSize; i++)
 	{
 		m_imag[i] *= -1;
 	}
-	bitReverseComplex();
-	fft();
-	// copy the result in real into buffer, scaling as we do
-	for (int i = 0; i < m_timeSize; i++)
+	bitReverseComplex(halfSize);
+	fft(halfSize);
+	// its real part is the even samples and its imaginary part the odd, scaling as we copy
+	for (int i = 0; i < halfSize; i++)
+	{
+		buffer[2*i]	  = m_real[i] / halfSize;
+		buffer[2*i+1] = -m_imag[i] / halfSize;
+	}
+}
+
+void Minim::FFT::splitHalfSpectrum()
+{
+	// Z = E + iO, where E and O are the spectra of the even and odd samples,
+	// and X[k] = E[k] + exp(-2*PI*i*k/N) * O[k]. Z[k] and Z[N/2-k] together give
+	// X[k] and X[N/2-k], so we go through them in pairs.
+	const int N = m_timeSize;
+	const int halfSize = N/2;
+	
+	const float z0r = m_real[0];
+	const float z0i = m_imag[0];
+	m_real[0] = z0r + z0i;
+	m_imag[0] = 0;
+	m_real[halfSize] = z0r - z0i;
+	m_imag[halfSize] = 0;
+	
+	for (int k = 1; k <= halfSize/2; ++k)
+	{
+		const int j = halfSize - k;
+		const float zkr = m_real[k], zki = m_imag[k];
+		const float zjr = m_real[j], zji = m_imag[j];
+		
+		// for k: E = (Z[k] + conj(Z[j]))/2, O = (Z[k] - conj(Z[j]))/2i
+		const float er = 0.5f * (zkr + zjr);
+		const float ei = 0.5f * (zki - zji);
+		const float or_ = 0.5f * (zki + zji);
+		const float oi = -0.5f * (zkr - zjr);
+		const float wr = coslu(k);
+		const float wi = sinlu(k);
+		const float tr = wr*or_ - wi*oi;
+		const float ti = wr*oi + wi*or_;
+		
+		// for j, E is the conjugate of E for k, O the conjugate of O for k,
+		// and the phase shift is minus the conjugate of the one for k.
+		m_real[k] = er + tr;
+		m_imag[k] = ei + ti;
+		m_real[j] = er - tr;
+		m_imag[j] = -ei + ti;
+	}
+	
+	// the spectrum of a real signal is symmetric
+	for (int k = 1; k < halfSize; ++k)
 	{
-		buffer[i] = m_real[i] / m_timeSize;
+		m_real[N-k] = m_real[k];
+		m_imag[N-k] = -m_imag[k];
 	}
 }
 
-void Minim::FFT::fft()
+void Minim::FFT::joinHalfSpectrum()
 {
-	for (int halfSize = 1; halfSize < m_timeSize; halfSize *= 2)
-	{
-		//float k = -(float)M_PI/halfSize;
-		// phase shift step
-		//float phaseShiftStepR = cosf(k);
-		//float phaseShiftStepI = sinf(k);
-		// using lookup table
-		float phaseShiftStepR = coslu(halfSize);
-		float phaseShiftStepI = sinlu(halfSize);
-		// current phase shift
-		float currentPhaseShiftR = 1.0f;
-		float currentPhaseShiftI = 0.0f;
+	// the reverse of splitHalfSpectrum, taking the symmetric part of what's in the full spectrum:
+	// Y[k] = (X[k] + conj(X[N-k]))/2, E[k] = (Y[k] + conj(Y[N/2-k]))/2,
+	// O[k] = (Y[k] - conj(Y[N/2-k])) * exp(2*PI*i*k/N)/2, and Z[k] = E[k] + iO[k].
+	const int N = m_timeSize;
+	const int halfSize = N/2;
+	
+	const float y0 = m_real[0];
+	const float yh = m_real[halfSize];
+	m_real[0] = 0.5f * (y0 + yh);
+	m_imag[0] = 0.5f * (y0 - yh);
+	
+	for (int k = 1; k <= halfSize/2; ++k)
+	{
+		const int j = halfSize - k;
+		const float ykr = 0.5f * (m_real[k] + m_real[N-k]);
+		const float yki = 0.5f * (m_imag[k] - m_imag[N-k]);
+		const float yjr = 0.5f * (m_real[j] + m_real[N-j]);
+		const float yji = 0.5f * (m_imag[j] - m_imag[N-j]);
+		
+		const float er = 0.5f * (ykr + yjr);
+		const float ei = 0.5f * (yki - yji);
+		const float dr = 0.5f * (ykr - yjr);
+		const float di = 0.5f * (yki + yji);
+		// times the conjugate of the phase shift
+		const float wr = coslu(k);
+		const float wi = -sinlu(k);
+		const float or_ = dr*wr - di*wi;
+		const float oi = dr*wi + di*wr;
+		
+		// for j, E and O are the conjugates of those for k
+		m_real[k] = er - oi;
+		m_imag[k] = ei + or_;
+		m_real[j] = er + oi;
+		m_imag[j] = -ei + or_;
+	}
+}
+
+void Minim::FFT::fft(const int size)
+{
+	for (int halfSize = 1; halfSize < size; halfSize *= 2)
+	{
+		// the phase shift for each step is exp(-i*PI*fftStep/halfSize), which is every
+		// tableStride'th entry in the lookup tables. reading them, rather than multiplying
+		// by a step each time, keeps rounding errors from building up over large sizes.
+		const int tableStride = m_timeSize / (2*halfSize);
 		const int dubHalfSize = 2*halfSize;
 		for (int fftStep = 0; fftStep < halfSize; ++fftStep)
 		{
-			for (int i = fftStep; i < m_timeSize; i += dubHalfSize)
+			const float currentPhaseShiftR = coslu(fftStep*tableStride);
+			const float currentPhaseShiftI = sinlu(fftStep*tableStride);
+			for (int i = fftStep; i < size; i += dubHalfSize)
 			{
 				const int off = i + halfSize;
 				const float tr = (currentPhaseShiftR * m_real[off]) - (currentPhaseShiftI * m_imag[off]);
@@ -174,9 +266,6 @@ void Minim::FFT::fft()
 				m_real[i] += tr;
 				m_imag[i] += ti;
 			}
-			const float tmpR = currentPhaseShiftR;
-			currentPhaseShiftR = (tmpR * phaseShiftStepR) - (currentPhaseShiftI * phaseShiftStepI);
-			currentPhaseShiftI = (tmpR * phaseShiftStepI) + (currentPhaseShiftI * phaseShiftStepR);
 		}
 	}
 }
@@ -206,26 +295,53 @@ void Minim::FFT::bitReverseSamples(float * samples, int startAt)
 	}
 }
 
-void Minim::FFT::bitReverseComplex()
+void Minim::FFT::bitReverseSamplePairs(const float * samples)
 {
-	for (int i = 0; i < m_timeSize; i++)
+	// reversing i in half as many bits is reverse[i]/2, so the pair for i starts at reverse[i]
+	const int halfSize = m_timeSize/2;
+	for (int i = 0; i < halfSize; ++i)
 	{
-		m_reverseReal[i] = m_real[reverse[i]];
-		m_reverseImag[i] = m_imag[reverse[i]];
+		m_real[i] = samples[ reverse[i] ];
+		m_imag[i] = samples[ reverse[i] + 1 ];
+	}
+}
+
+void Minim::FFT::bitReverseComplex(const int size)
+{
+	// swapping in place, each pair only once. for sizes less than ours,
+	// reversing in fewer bits is the same as shifting our reverse down.
+	int shift = 0;
+	while ( (size << shift) < m_timeSize )
+	{
+		++shift;
 	}
 	
-	memcpy(m_real, m_reverseReal, m_timeSize*sizeof(float));
-	memcpy(m_imag, m_reverseImag, m_timeSize*sizeof(float));
+	for (int i = 0; i < size; i++)
+	{
+		const int r = reverse[i] >> shift;
+		if ( r > i )
+		{
+			const float tr = m_real[i];
+			const float ti = m_imag[i];
+			m_real[i] = m_real[r];
+			m_imag[i] = m_imag[r];
+			m_real[r] = tr;
+			m_imag[r] = ti;
+		}
+	}
 }
 
 void Minim::FFT::buildTrigTables()
 {
+	// exp(-2*PI*i/N) for the first half of the circle, computed in double so the
+	// table is as accurate as a float can be.
 	int N = m_timeSize;
-	sinlookup = new float[N];
-	coslookup = new float[N];
-	for (int i = 0; i < N; i++)
+	int halfN = N > 1 ? N / 2 : 1;
+	sinlookup = new float[halfN];
+	coslookup = new float[halfN];
+	for (int i = 0; i < halfN; i++)
 	{
-		sinlookup[i] = sinf(-(float)M_PI / i);
-		coslookup[i] = cosf(-(float)M_PI / i);
+		sinlookup[i] = (float)sin(-2 * M_PI * i / N);
+		coslookup[i] = (float)cos(-2 * M_PI * i / N);
 	}
 }
@@ -47,9 +47,9 @@ namespace Minim
 		
 	private:
 		
-		// performs an in-place fft on the data in the real and imag arrays
+		// performs an in-place fft on the first size values of the real and imag arrays
 		// bit reversing is not necessary as the data will already be bit reversed
-		void fft();
+		void fft(const int size);
 		
 		// table used for bit-reversing arrays
 		int * reverse;
@@ -60,10 +60,21 @@ namespace Minim
 		// in bit reversed order. the imag array is filled with zeros.
 		void bitReverseSamples(float * samples, int startAt);
 		
-		// bit reverse real[] and imag[]
-		void bitReverseComplex();
+		// copies pairs of samples into the first half of the real and imag arrays,
+		// even samples as real and odd samples as imaginary, in bit reversed order.
+		void bitReverseSamplePairs(const float * samples);
 		
-		// lookup tables
+		// bit reverse the first size values of real[] and imag[], in place
+		void bitReverseComplex(const int size);
+		
+		// turns the spectrum of the sample pairs in the first half of real[] and imag[]
+		// into the spectrum of the samples, filling all of real[] and imag[].
+		void splitHalfSpectrum();
+		
+		// the reverse of splitHalfSpectrum, from the symmetric part of the spectrum in real[] and imag[]
+		void joinHalfSpectrum();
+		
+		// lookup tables, sin and cos of -2*PI*i/timeSize for the first half of the circle
 		
 		float * sinlookup;
 		float * coslookup;
@@ -79,9 +90,5 @@ namespace Minim
 		}
 		
 		void buildTrigTables();
-
-		// arrays used for bit-reversing our complex data.
-		float *	m_reverseReal;
-		float * m_reverseImag;
 	};
 };
@@ -9,7 +9,8 @@
 
 #include "FourierTransform.h"
 
-#include <string>
+#include <string.h> // for memcpy
+#include <stdio.h> // for printf
 
 Minim::RectangularWindow Minim::FourierTransform::NONE;
 Minim::TriangularWindow Minim::FourierTransform::TRIANGULAR;
@@ -0,0 +1,156 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace Minim
+{
+	/**
+	 * A bounded queue that any number of threads can push to and pop from at the same time 
+	 * without locking, so that the audio thread never has to wait on anyone to get at it.
+	 * Each slot has a sequence number that says whether it's ready to be written or read
+	 * for the current lap around the queue, so pushing and popping are a compare-and-swap 
+	 * on a position plus a copy. Nothing is allocated after construction.
+	 *
+	 * T is copied in and out, so it should be small and cheap to copy.
+	 */
+	template<typename T>
+	class LockFreeQueue
+	{
+	public:
+		// capacity is rounded up to a power of two
+		explicit LockFreeQueue( const size_t capacity )
+		: mCapacity( roundUp( capacity ) )
+		, mMask( mCapacity - 1 )
+		, mSlots( new Slot[ mCapacity ] )
+		, mPushPosition( 0 )
+		, mPopPosition( 0 )
+		{
+			for( size_t i = 0; i < mCapacity; ++i )
+			{
+				mSlots[i].sequence.store( i, std::memory_order_relaxed );
+			}
+		}
+		
+		~LockFreeQueue()
+		{
+			delete [] mSlots;
+		}
+		
+		inline size_t capacity() const { return mCapacity; }
+		
+		// returns false without waiting if the queue is full
+		bool push( const T & value )
+		{
+			size_t pos = mPushPosition.load( std::memory_order_relaxed );
+			for(;;)
+			{
+				Slot & slot = mSlots[ pos & mMask ];
+				const size_t seq = slot.sequence.load( std::memory_order_acquire );
+				const ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+				if ( diff == 0 )
+				{
+					if ( mPushPosition.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+					{
+						slot.value = value;
+						slot.sequence.store( pos + 1, std::memory_order_release );
+						return true;
+					}
+				}
+				else if ( diff < 0 )
+				{
+					// whoever is a lap behind us hasn't popped this slot yet
+					return false;
+				}
+				else
+				{
+					pos = mPushPosition.load( std::memory_order_relaxed );
+				}
+			}
+		}
+		
+		// returns false without waiting if the queue is empty
+		bool pop( T & value )
+		{
+			size_t pos = mPopPosition.load( std::memory_order_relaxed );
+			for(;;)
+			{
+				Slot & slot = mSlots[ pos & mMask ];
+				const size_t seq = slot.sequence.load( std::memory_order_acquire );
+				const ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)(pos + 1);
+				if ( diff == 0 )
+				{
+					if ( mPopPosition.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+					{
+						value = slot.value;
+						// ready to be pushed to on the next lap
+						slot.sequence.store( pos + mCapacity, std::memory_order_release );
+						return true;
+					}
+				}
+				else if ( diff < 0 )
+				{
+					return false;
+				}
+				else
+				{
+					pos = mPopPosition.load( std::memory_order_relaxed );
+				}
+			}
+		}
+		
+	private:
+		
+		static size_t roundUp( const size_t capacity )
+		{
+			size_t size = 2;
+			while ( size < capacity )
+			{
+				size <<= 1;
+			}
+			return size;
+		}
+		
+		struct Slot
+		{
+			std::atomic<size_t> sequence;
+			T					value;
+		};
+		
+		// not copyable
+		LockFreeQueue( const LockFreeQueue & );
+		LockFreeQueue & operator=( const LockFreeQueue & );
+		
+		const size_t		mCapacity;
+		const size_t		mMask;
+		Slot *				mSlots;
+		
+		// kept on their own cache lines so producers and the consumer don't slow each other down
+		char				mPad0[64];
+		std::atomic<size_t>	mPushPosition;
+		char				mPad1[64];
+		std::atomic<size_t>	mPopPosition;
+		char				mPad2[64];
+	};
+}
+
+#endif // LOCKFREEQUEUE_H
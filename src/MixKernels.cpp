@@ -0,0 +1,405 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "MixKernels.h"
+
+#include <cstring>
+
+// SSE2 is part of every x64 CPU, so it is always compiled in there.
+// AVX2 is compiled in as well, but only used if cpuid says we can.
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+	#define MIX_KERNELS_X86 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define MIX_KERNELS_AVX2
+	#else
+		#include <cpuid.h>
+		#define MIX_KERNELS_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+namespace Minim
+{
+namespace MixKernels
+{
+	///////////////////////////////////////////////////
+	// plain loops, used when there's nothing better and to finish what the vector versions leave over
+
+	static void fillScalar( float * dst, const float value, const int numSamples )
+	{
+		for( int i = 0; i < numSamples; ++i )
+		{
+			dst[i] = value;
+		}
+	}
+
+	static void accumScalar( float * dst, const float * src, const float gain, const int numSamples )
+	{
+		for( int i = 0; i < numSamples; ++i )
+		{
+			dst[i] += src[i] * gain;
+		}
+	}
+
+	static void accumBlockScalar( float * dst, const float * src, const float * gain, const int numSamples )
+	{
+		for( int i = 0; i < numSamples; ++i )
+		{
+			dst[i] += src[i] * gain[i];
+		}
+	}
+
+	static void rampScalar( float * dst, const float * src, const float from, const float to, const int offset, const int length, const int numSamples )
+	{
+		for( int i = 0; i < numSamples; ++i )
+		{
+			dst[i] = src[i] * ( from + ( to - from ) * ( (float)( offset + i ) / length ) );
+		}
+	}
+
+	static void interleaveScalar( float * dst, const float * const * src, const int numChannels, const int numFrames )
+	{
+		if ( numChannels == 1 )
+		{
+			memcpy( dst, src[0], sizeof(float)*numFrames );
+			return;
+		}
+
+		for( int c = 0; c < numChannels; ++c )
+		{
+			const float * in = src[c];
+			float * out = dst + c;
+			for( int f = 0; f < numFrames; ++f, out += numChannels )
+			{
+				*out = in[f];
+			}
+		}
+	}
+
+	static void accumWavetableScalar( float * dst, const float * table, const int tableBits, unsigned int & phase, const unsigned int increment, const float gain, const int numSamples )
+	{
+		const int	fracShift = 32 - tableBits;
+		const float fracScale = 1.f / 16777216.f;
+		unsigned int p = phase;
+		for( int i = 0; i < numSamples; ++i )
+		{
+			const unsigned int index = p >> fracShift;
+			// the 24 bits under the index, which a float holds exactly
+			const float frac = (float)( ( p << tableBits ) >> 8 ) * fracScale;
+			const float t0	 = table[index];
+			const float t1	 = table[index + 1];
+			dst[i] += gain * ( t0 + ( t1 - t0 ) * frac );
+			p += increment;
+		}
+		phase = p;
+	}
+
+#ifdef MIX_KERNELS_X86
+
+	///////////////////////////////////////////////////
+	// SSE2, four samples at a time
+
+	static void fillSSE2( float * dst, const float value, const int numSamples )
+	{
+		const __m128 v = _mm_set1_ps( value );
+		int i = 0;
+		for( ; i + 4 <= numSamples; i += 4 )
+		{
+			_mm_storeu_ps( dst + i, v );
+		}
+		fillScalar( dst + i, value, numSamples - i );
+	}
+
+	static void accumSSE2( float * dst, const float * src, const float gain, const int numSamples )
+	{
+		const __m128 g = _mm_set1_ps( gain );
+		int i = 0;
+		for( ; i + 4 <= numSamples; i += 4 )
+		{
+			const __m128 s = _mm_mul_ps( _mm_loadu_ps( src + i ), g );
+			_mm_storeu_ps( dst + i, _mm_add_ps( _mm_loadu_ps( dst + i ), s ) );
+		}
+		accumScalar( dst + i, src + i, gain, numSamples - i );
+	}
+
+	static void accumBlockSSE2( float * dst, const float * src, const float * gain, const int numSamples )
+	{
+		int i = 0;
+		for( ; i + 4 <= numSamples; i += 4 )
+		{
+			const __m128 s = _mm_mul_ps( _mm_loadu_ps( src + i ), _mm_loadu_ps( gain + i ) );
+			_mm_storeu_ps( dst + i, _mm_add_ps( _mm_loadu_ps( dst + i ), s ) );
+		}
+		accumBlockScalar( dst + i, src + i, gain + i, numSamples - i );
+	}
+
+	static void rampSSE2( float * dst, const float * src, const float from, const float to, const int offset, const int length, const int numSamples )
+	{
+		const __m128 f = _mm_set1_ps( from );
+		const __m128 d = _mm_set1_ps( to - from );
+		const __m128 l = _mm_set1_ps( (float)length );
+		__m128i index  = _mm_add_epi32( _mm_set1_epi32( offset ), _mm_set_epi32( 3, 2, 1, 0 ) );
+		const __m128i four = _mm_set1_epi32( 4 );
+		int i = 0;
+		for( ; i + 4 <= numSamples; i += 4 )
+		{
+			const __m128 t = _mm_div_ps( _mm_cvtepi32_ps( index ), l );
+			const __m128 g = _mm_add_ps( f, _mm_mul_ps( d, t ) );
+			_mm_storeu_ps( dst + i, _mm_mul_ps( _mm_loadu_ps( src + i ), g ) );
+			index = _mm_add_epi32( index, four );
+		}
+		rampScalar( dst + i, src + i, from, to, offset + i, length, numSamples - i );
+	}
+
+	static void interleaveSSE2( float * dst, const float * const * src, const int numChannels, const int numFrames )
+	{
+		if ( numChannels != 2 )
+		{
+			interleaveScalar( dst, src, numChannels, numFrames );
+			return;
+		}
+
+		const float * left	= src[0];
+		const float * right = src[1];
+		int f = 0;
+		for( ; f + 4 <= numFrames; f += 4 )
+		{
+			const __m128 l = _mm_loadu_ps( left + f );
+			const __m128 r = _mm_loadu_ps( right + f );
+			_mm_storeu_ps( dst + 2*f,	  _mm_unpacklo_ps( l, r ) );
+			_mm_storeu_ps( dst + 2*f + 4, _mm_unpackhi_ps( l, r ) );
+		}
+		for( ; f < numFrames; ++f )
+		{
+			dst[2*f]	 = left[f];
+			dst[2*f + 1] = right[f];
+		}
+	}
+
+	///////////////////////////////////////////////////
+	// AVX2, eight samples at a time. no FMA, so results match the others exactly.
+
+	MIX_KERNELS_AVX2 static void fillAVX2( float * dst, const float value, const int numSamples )
+	{
+		const __m256 v = _mm256_set1_ps( value );
+		int i = 0;
+		for( ; i + 8 <= numSamples; i += 8 )
+		{
+			_mm256_storeu_ps( dst + i, v );
+		}
+		fillScalar( dst + i, value, numSamples - i );
+	}
+
+	MIX_KERNELS_AVX2 static void accumAVX2( float * dst, const float * src, const float gain, const int numSamples )
+	{
+		const __m256 g = _mm256_set1_ps( gain );
+		int i = 0;
+		for( ; i + 8 <= numSamples; i += 8 )
+		{
+			const __m256 s = _mm256_mul_ps( _mm256_loadu_ps( src + i ), g );
+			_mm256_storeu_ps( dst + i, _mm256_add_ps( _mm256_loadu_ps( dst + i ), s ) );
+		}
+		accumScalar( dst + i, src + i, gain, numSamples - i );
+	}
+
+	MIX_KERNELS_AVX2 static void accumBlockAVX2( float * dst, const float * src, const float * gain, const int numSamples )
+	{
+		int i = 0;
+		for( ; i + 8 <= numSamples; i += 8 )
+		{
+			const __m256 s = _mm256_mul_ps( _mm256_loadu_ps( src + i ), _mm256_loadu_ps( gain + i ) );
+			_mm256_storeu_ps( dst + i, _mm256_add_ps( _mm256_loadu_ps( dst + i ), s ) );
+		}
+		accumBlockScalar( dst + i, src + i, gain + i, numSamples - i );
+	}
+
+	MIX_KERNELS_AVX2 static void rampAVX2( float * dst, const float * src, const float from, const float to, const int offset, const int length, const int numSamples )
+	{
+		const __m256 f = _mm256_set1_ps( from );
+		const __m256 d = _mm256_set1_ps( to - from );
+		const __m256 l = _mm256_set1_ps( (float)length );
+		__m256i index  = _mm256_add_epi32( _mm256_set1_epi32( offset ), _mm256_set_epi32( 7, 6, 5, 4, 3, 2, 1, 0 ) );
+		const __m256i eight = _mm256_set1_epi32( 8 );
+		int i = 0;
+		for( ; i + 8 <= numSamples; i += 8 )
+		{
+			const __m256 t = _mm256_div_ps( _mm256_cvtepi32_ps( index ), l );
+			const __m256 g = _mm256_add_ps( f, _mm256_mul_ps( d, t ) );
+			_mm256_storeu_ps( dst + i, _mm256_mul_ps( _mm256_loadu_ps( src + i ), g ) );
+			index = _mm256_add_epi32( index, eight );
+		}
+		rampScalar( dst + i, src + i, from, to, offset + i, length, numSamples - i );
+	}
+
+	MIX_KERNELS_AVX2 static void accumWavetableAVX2( float * dst, const float * table, const int tableBits, unsigned int & phase, const unsigned int increment, const float gain, const int numSamples )
+	{
+		const __m128i fracShift = _mm_cvtsi32_si128( 32 - tableBits );
+		const __m128i indexBits = _mm_cvtsi32_si128( tableBits );
+		const __m256  fracScale = _mm256_set1_ps( 1.f / 16777216.f );
+		const __m256  g			= _mm256_set1_ps( gain );
+		const unsigned int inc	= increment;
+		__m256i p = _mm256_add_epi32( _mm256_set1_epi32( (int)phase ),
+									  _mm256_set_epi32( (int)(7*inc), (int)(6*inc), (int)(5*inc), (int)(4*inc), (int)(3*inc), (int)(2*inc), (int)inc, 0 ) );
+		const __m256i step = _mm256_set1_epi32( (int)(8*inc) );
+		int i = 0;
+		for( ; i + 8 <= numSamples; i += 8 )
+		{
+			const __m256i index = _mm256_srl_epi32( p, fracShift );
+			const __m256  frac	= _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_srli_epi32( _mm256_sll_epi32( p, indexBits ), 8 ) ), fracScale );
+			const __m256  t0	= _mm256_i32gather_ps( table, index, 4 );
+			const __m256  t1	= _mm256_i32gather_ps( table + 1, index, 4 );
+			const __m256  v		= _mm256_add_ps( t0, _mm256_mul_ps( _mm256_sub_ps( t1, t0 ), frac ) );
+			_mm256_storeu_ps( dst + i, _mm256_add_ps( _mm256_loadu_ps( dst + i ), _mm256_mul_ps( g, v ) ) );
+			p = _mm256_add_epi32( p, step );
+		}
+		unsigned int rest = phase + (unsigned int)i * inc;
+		accumWavetableScalar( dst + i, table, tableBits, rest, increment, gain, numSamples - i );
+		phase = rest;
+	}
+
+	// whether the CPU has AVX2 and the OS saves the registers it needs
+	static bool hasAVX2()
+	{
+	#if defined(_MSC_VER)
+		int info[4];
+		__cpuid( info, 0 );
+		if ( info[0] < 7 )
+		{
+			return false;
+		}
+		__cpuid( info, 1 );
+		const bool osxsave = ( info[2] & (1 << 27) ) != 0;
+		const bool avx	   = ( info[2] & (1 << 28) ) != 0;
+		if ( !osxsave || !avx || ( _xgetbv( 0 ) & 6 ) != 6 )
+		{
+			return false;
+		}
+		__cpuidex( info, 7, 0 );
+		return ( info[1] & (1 << 5) ) != 0;
+	#else
+		unsigned int a, b, c, d;
+		if ( !__get_cpuid( 0, &a, &b, &c, &d ) || a < 7 )
+		{
+			return false;
+		}
+		__get_cpuid( 1, &a, &b, &c, &d );
+		const bool osxsave = ( c & (1 << 27) ) != 0;
+		const bool avx	   = ( c & (1 << 28) ) != 0;
+		if ( !osxsave || !avx )
+		{
+			return false;
+		}
+		unsigned int xcr0, xcr0High;
+		__asm__ __volatile__ ( "xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0) );
+		if ( ( xcr0 & 6 ) != 6 )
+		{
+			return false;
+		}
+		__cpuid_count( 7, 0, a, b, c, d );
+		return ( b & (1 << 5) ) != 0;
+	#endif
+	}
+
+#endif // MIX_KERNELS_X86
+
+	///////////////////////////////////////////////////
+	// picking which ones to use
+
+	struct Kernels
+	{
+		const char * name;
+		void (*fill)( float *, const float, const int );
+		void (*accum)( float *, const float *, const float, const int );
+		void (*accumBlock)( float *, const float *, const float *, const int );
+		void (*ramp)( float *, const float *, const float, const float, const int, const int, const int );
+		void (*interleave)( float *, const float * const *, const int, const int );
+		void (*accumWavetable)( float *, const float *, const int, unsigned int &, const unsigned int, const float, const int );
+	};
+
+	static Kernels chooseKernels()
+	{
+		Kernels kernels = { "scalar", fillScalar, accumScalar, accumBlockScalar, rampScalar, interleaveScalar, accumWavetableScalar };
+
+	#ifdef MIX_KERNELS_X86
+		if ( hasAVX2() )
+		{
+			// interleaving two channels is all shuffling, SSE2 does that just as well
+			Kernels avx2 = { "AVX2", fillAVX2, accumAVX2, accumBlockAVX2, rampAVX2, interleaveSSE2, accumWavetableAVX2 };
+			kernels = avx2;
+		}
+		else
+		{
+			// without a gather, table lookups are one at a time anyway
+			Kernels sse2 = { "SSE2", fillSSE2, accumSSE2, accumBlockSSE2, rampSSE2, interleaveSSE2, accumWavetableScalar };
+			kernels = sse2;
+		}
+	#endif
+
+		return kernels;
+	}
+
+	static const Kernels & getKernels()
+	{
+		static const Kernels kernels = chooseKernels();
+		return kernels;
+	}
+
+	///////////////////////////////////////////////////
+	void fill( float * dst, const float value, const int numSamples )
+	{
+		getKernels().fill( dst, value, numSamples );
+	}
+
+	///////////////////////////////////////////////////
+	void accum( float * dst, const float * src, const float gain, const int numSamples )
+	{
+		getKernels().accum( dst, src, gain, numSamples );
+	}
+
+	///////////////////////////////////////////////////
+	void accum( float * dst, const float * src, const float * gain, const int numSamples )
+	{
+		getKernels().accumBlock( dst, src, gain, numSamples );
+	}
+
+	///////////////////////////////////////////////////
+	void ramp( float * dst, const float * src, const float from, const float to, const int offset, const int length, const int numSamples )
+	{
+		getKernels().ramp( dst, src, from, to, offset, length, numSamples );
+	}
+
+	///////////////////////////////////////////////////
+	void interleave( float * dst, const float * const * src, const int numChannels, const int numFrames )
+	{
+		getKernels().interleave( dst, src, numChannels, numFrames );
+	}
+
+	///////////////////////////////////////////////////
+	void accumWavetable( float * dst, const float * table, const int tableBits, unsigned int & phase, const unsigned int increment, const float gain, const int numSamples )
+	{
+		getKernels().accumWavetable( dst, table, tableBits, phase, increment, gain, numSamples );
+	}
+	
+	///////////////////////////////////////////////////
+	const char * getName()
+	{
+		return getKernels().name;
+	}
+}
+}
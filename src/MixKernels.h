@@ -0,0 +1,63 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef MIXKERNELS_H
+#define MIXKERNELS_H
+
+namespace Minim
+{
+	/**
+	 * The loops that mixing spends most of its time in, over whole blocks of samples.
+	 *
+	 * On x86 the first call picks AVX2 or SSE2 versions, depending on what the CPU supports.
+	 * Everywhere else they are plain loops, which the compiler is free to vectorize.
+	 * Every version multiplies and adds separately, in the same order as the plain loops,
+	 * so the output is exactly the same no matter which one runs.
+	 *
+	 * None of the pointers need to be aligned. dst may be the same as src, except when interleaving.
+	 */
+	namespace MixKernels
+	{
+		// dst[i] = value
+		void fill( float * dst, const float value, const int numSamples );
+
+		// dst[i] += src[i] * gain
+		void accum( float * dst, const float * src, const float gain, const int numSamples );
+
+		// dst[i] += src[i] * gain[i]
+		void accum( float * dst, const float * src, const float * gain, const int numSamples );
+
+		// dst[i] = src[i] * ( from + ( to - from ) * ( (float)( offset + i ) / length ) )
+		// which is a gain ramp from `from` to `to` over length samples, starting offset samples in.
+		void ramp( float * dst, const float * src, const float from, const float to, const int offset, const int length, const int numSamples );
+
+		// dst[f*numChannels + c] = src[c][f]
+		void interleave( float * dst, const float * const * src, const int numChannels, const int numFrames );
+
+		// dst[i] += gain * lookup( table, phase ), then phase += increment, for numSamples samples.
+		// phase is a fixed point fraction of a cycle, the whole 32 bits being one cycle, and wraps around.
+		// table holds 2^tableBits samples of one cycle plus a copy of the first one at the end,
+		// and is linearly interpolated. phase is left where the next sample would be.
+		void accumWavetable( float * dst, const float * table, const int tableBits, unsigned int & phase, const unsigned int increment, const float gain, const int numSamples );
+
+		// which versions are being used: "AVX2", "SSE2", or "scalar"
+		const char * getName();
+	}
+}
+
+#endif // MIXKERNELS_H
@@ -25,6 +25,7 @@ namespace Minim
 
 	MultiChannelBuffer::MultiChannelBuffer()
 	: mBufferSize(0)
+	, mCapacity(0)
 	, mChannels(NULL)
 	, mChannelCount(0)
 	{
@@ -32,6 +33,7 @@ namespace Minim
 
 	MultiChannelBuffer::MultiChannelBuffer( int numChannels, int bufferSize )
 	: mBufferSize(bufferSize)
+	, mCapacity(bufferSize)
 	, mChannels(NULL)
 	, mChannelCount(0)
 	{
@@ -40,6 +42,7 @@ namespace Minim
 
 	MultiChannelBuffer::MultiChannelBuffer( const MultiChannelBuffer & other )
 	: mBufferSize(other.mBufferSize)
+	, mCapacity(other.mBufferSize)
 	, mChannels(NULL)
 	, mChannelCount(0)
 	{
@@ -94,7 +97,7 @@ namespace Minim
 	////////////////////////////////////////////////////////////
 	void MultiChannelBuffer::setBufferSize( const int bufferSize )
 	{
-		if ( bufferSize != mBufferSize )
+		if ( bufferSize > mCapacity )
 		{
 			if ( mChannels )
 			{
@@ -107,8 +110,9 @@ namespace Minim
 					mChannels[i] = new float[bufferSize];
 				}
 			}
-			mBufferSize = bufferSize;
+			mCapacity = bufferSize;
 		}
+		mBufferSize = bufferSize;
 	}
 
 	////////////////////////////////////////////////////////////
@@ -121,7 +125,7 @@ namespace Minim
 			mChannelCount = numChannels;
 			for(int i = 0; i < mChannelCount; ++i)
 			{
-				mChannels[i] = new float[mBufferSize];
+				mChannels[i] = new float[mCapacity];
 			}
 		}
 	}
@@ -31,6 +31,8 @@ namespace Minim
 		~MultiChannelBuffer();
 
 		inline int getBufferSize() const { return mBufferSize; }
+		// channels are only reallocated when they need to grow, 
+		// so going back and forth between sizes doesn't allocate.
 		void setBufferSize( const int bufferSize );
 		
 		inline int getChannelCount() const { return mChannelCount; }
@@ -38,6 +40,8 @@ namespace Minim
 
 		float * getChannel( const int channelNum );
 		const float * getChannel( const int channelNum ) const;
+		// all of the channels at once, for handing to MixKernels::interleave
+		inline const float * const * getChannels() const { return mChannels; }
 		
 		// get an exact sample. equivalent to getChannel(inChannel)[sampleNum]
 		float getSample( const int inChannel, const int sampleNum ) const;
@@ -51,6 +55,8 @@ namespace Minim
 		void deleteChannels();
 
 		int mBufferSize;
+		// how many samples each channel has room for, at least mBufferSize
+		int mCapacity;
 
 		typedef float* Buffer;
 		Buffer *mChannels;
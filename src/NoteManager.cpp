@@ -10,17 +10,30 @@
 #include "NoteManager.h"
 #include "AudioOutput.h"
 
+#include <algorithm>
+
 namespace Minim 
 {	
+	// how many events we have room for before anything is allocated
+	static const int kEventCapacity = 4096;
+	
+	// the NoteManager this thread is ticking, if any. post uses it to tell when it has been called
+	// from an Instrument that is being sent an event, which is to say from the audio thread.
+	static thread_local NoteManager * s_ticking = NULL;
+	
 	NoteManager::NoteManager(AudioOutput & parent)
 	: m_out(parent)
 	, m_tempo(60.f)
 	, m_noteOffset(0.f)
 	, m_durationFactor(1.0f)
 	, m_now(0)
+	, m_order(0)
+	, m_inbox(kEventCapacity)
+	, m_hasOverflow(false)
+	, m_droppedEvents(0)
 	, m_paused(false)
-	, m_busy(false)
 	{
+		m_events.reserve( kEventCapacity );
 	}
 	
 	NoteManager::~NoteManager()
@@ -52,33 +65,112 @@ namespace Minim
 	{		
 		int onAt = m_now + (int)(m_out.sampleRate() * ( startTime + m_noteOffset ) * 60.f / m_tempo);
 		
-		m_events[onAt].push_back( NoteEvent(&instrument, NoteEvent::NOTE_ON, duration) );
+		post( NoteEvent(&instrument, NoteEvent::NOTE_ON, duration, onAt) );
 		
 		int offAt = onAt + (int)(m_out.sampleRate() * duration * m_durationFactor * 60.f / m_tempo);
 		
-		m_events[offAt].push_back( NoteEvent(&instrument, NoteEvent::NOTE_OFF, 0.f) );
+		post( NoteEvent(&instrument, NoteEvent::NOTE_OFF, 0.f, offAt) );
 	}
 	
-	void NoteManager::tick()
+	void NoteManager::post( const NoteEvent & event )
 	{
-		if ( m_paused == false )
+		// m_events is ours on the audio thread, so we put the event straight into it,
+		// as long as doing so won't allocate. otherwise it is lost, since we can't wait on the overflow.
+		if ( s_ticking == this )
 		{
-			// find the events we should trigger now.
-			TNoteEventMap::iterator eventsIter = m_events.find(m_now);
-			if ( eventsIter != m_events.end() )
+			if ( m_events.size() < m_events.capacity() )
+			{
+				NoteEvent copy( event );
+				insert( copy );
+			}
+			else
+			{
+				++m_droppedEvents;
+			}
+			return;
+		}
+		
+		if ( !m_hasOverflow && m_inbox.push( event ) )
+		{
+			return;
+		}
+		
+		std::lock_guard<std::mutex> lock( m_overflowMutex );
+		m_overflow.push_back( event );
+		m_hasOverflow = true;
+	}
+	
+	void NoteManager::receive()
+	{
+		NoteEvent event;
+		while ( m_inbox.pop( event ) )
+		{
+			insert( event );
+		}
+		
+		if ( m_hasOverflow && m_overflowMutex.try_lock() )
+		{
+			// anything added to the inbox while we were getting the lock came before this
+			while ( m_inbox.pop( event ) )
+			{
+				insert( event );
+			}
+			for( size_t i = 0; i < m_overflow.size(); ++i )
 			{
-				TNoteEventList & eventsToSend = eventsIter->second;
-				for(int i = 0; i < eventsToSend.size(); ++i)
-				{
-					eventsToSend[i].send();
-				}
-				eventsToSend.clear();
-				// remove this list because we've sent all the events
-				m_events.erase( eventsIter );
+				insert( m_overflow[i] );
 			}
+			m_overflow.clear();
+			m_hasOverflow = false;
+			m_overflowMutex.unlock();
+		}
+	}
+	
+	void NoteManager::insert( NoteEvent & event )
+	{
+		event.setOrder( m_order++ );
+		m_events.push_back( event );
+		std::push_heap( m_events.begin(), m_events.end() );
+	}
+	
+	int NoteManager::tick( const int maxFrames )
+	{
+		s_ticking = this;
+		
+		receive();
+		
+		if ( m_paused )
+		{
+			// time doesn't move while we are paused
+			s_ticking = NULL;
+			return maxFrames;
+		}
+		
+		// send the events we should trigger now, along with any that were added too late 
+		// to be sent on time. sending an event might add more events at this time, 
+		// so we take those in after every one.
+		const int now = m_now;
+		while ( !m_events.empty() && m_events.front().getTime() <= now )
+		{
+			std::pop_heap( m_events.begin(), m_events.end() );
+			NoteEvent event = m_events.back();
+			m_events.pop_back();
 			
-			// increment our now
-			++m_now;
+			event.send();
+			
+			receive();
+		}
+		
+		// advance up to the next event, but no further than we were asked to
+		int frames = maxFrames;
+		if ( !m_events.empty() && m_events.front().getTime() - now < frames )
+		{
+			frames = m_events.front().getTime() - now;
 		}
+		
+		m_now = now + frames;
+		
+		s_ticking = NULL;
+		
+		return frames;
 	}
 }
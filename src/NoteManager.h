@@ -11,8 +11,10 @@
 #define	NOTEMANAGER_H
 
 #include "Instrument.h"
+#include "LockFreeQueue.h"
 
-#include <map>
+#include <atomic>
+#include <mutex>
 #include <vector>
 
 namespace Minim 
@@ -28,7 +30,16 @@ namespace Minim
 		
 		// events are always specified as happening some period of time from now.
 		// but we store them as taking place at a specific time, rather than a relative time.
+		// this can be called from any thread, including from an Instrument while it is sent an event.
+		// when an Instrument does that, there must already be room for the event, since the audio thread
+		// never waits on a lock or allocates here. events that don't fit are dropped and counted.
 		void addEvent(const float startTime, const float duration, Instrument & instrument);
+		
+		// how many events an Instrument tried to add while it was sent an event and there was no room for
+		inline unsigned int getDroppedEventCount() const
+		{
+			return m_droppedEvents;
+		}
 
 		
 		inline void setTempo(const float tempo)
@@ -61,7 +72,11 @@ namespace Minim
 			m_paused = false;
 		}
 		
-		void tick();
+		// sends all events scheduled for the current sample frame and then advances
+		// by as many sample frames as we can without skipping over another event,
+		// but never more than maxFrames. returns how many frames we advanced,
+		// which is how many frames can be generated before tick should be called again.
+		int tick( const int maxFrames );
 		
 	private:
 		
@@ -74,48 +89,88 @@ namespace Minim
 				NOTE_OFF
 			};
 			
-			NoteEvent( Instrument * instrument, Type type, float duration )
+			NoteEvent()
+			: mInstrument(NULL)
+			, mType(NOTE_ON)
+			, mDuration(0)
+			, mTime(0)
+			, mOrder(0)
+			{}
+			
+			NoteEvent( Instrument * instrument, Type type, float duration, int time )
 			: mInstrument(instrument)
 			, mType(type)
 			, mDuration(duration)
+			, mTime(time)
+			, mOrder(0)
 			{}
 			
 			void send();
 			
+			// for the heap, which puts the event that should be sent first at the front
+			inline bool operator<( const NoteEvent & other ) const
+			{
+				return mTime != other.mTime ? mTime > other.mTime : (int)(mOrder - other.mOrder) > 0;
+			}
+			
+			inline int getTime() const { return mTime; }
+			inline void setOrder( const unsigned int order ) { mOrder = order; }
+			
 		protected:
 			Instrument * mInstrument;
 			Type		 mType;
 			
 			// used for NOTE_ON
 			float		 mDuration;
+			
+			// the "now" the event should be sent at
+			int			 mTime;
+			// events at the same time are sent in the order they were added
+			unsigned int mOrder;
 		};
 		
+		// called by addEvent
+		void post( const NoteEvent & event );
+		// moves everything that has been added since the last time into m_events
+		void receive();
+		void insert( NoteEvent & event );
+		
 		AudioOutput & m_out;
 		
 		float m_tempo;
 		float m_noteOffset;
 		float m_durationFactor;
-		int   m_now;
+		// only moved forward by the audio thread, read by addEvent
+		std::atomic<int> m_now;
+		
+		// our events are kept in a binary heap ordered by when they should be sent,
+		// so the next event is always at the front and tick never has to search for it.
+		// it is only touched by the audio thread and has room for plenty of events up front,
+		// so that scheduling a score doesn't allocate while it plays.
+		typedef std::vector< NoteEvent > TNoteEventHeap;
+		TNoteEventHeap m_events;
+		unsigned int   m_order;
 		
+		// addEvent puts events here without blocking, and tick takes them out.
+		// if that fills up, they go in the overflow, which tick only takes if it can
+		// get the lock without waiting. once anything is in the overflow, everything 
+		// goes there until tick has emptied it, so that events stay in order.
+		LockFreeQueue< NoteEvent > m_inbox;
+		std::vector< NoteEvent >   m_overflow;
+		std::mutex				   m_overflowMutex;
+		std::atomic<bool>		   m_hasOverflow;
 		
-		// our events are stored in a map.
-		// the keys in this map are the "now" that the events should
-		// occur at and the values are a list of events that occur
-		// at that time.
-		typedef std::vector< NoteEvent > TNoteEventList;
-		typedef std::map< int, TNoteEventList > TNoteEventMap;
-		TNoteEventMap m_events;
+		// events that were added while tick was sending events, but didn't fit in m_events
+		std::atomic<unsigned int> m_droppedEvents;
 		
 		// are we paused?
 		// pausing is important because if we're going to queue up 
 		// a large number of notes, we want to make sure their timestamps
 		// are accurate. this won't be possible if the note manager
 		// is sending events because of ticks from the audio output.
-		bool m_paused;
-		
-		bool m_busy;
+		std::atomic<bool> m_paused;
 	};
 
 }
 
-#endif // NOTEMANAGER_H
\ No newline at end of file
+#endif // NOTEMANAGER_H
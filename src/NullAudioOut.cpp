@@ -0,0 +1,175 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "NullAudioOut.h"
+
+#include <chrono>
+
+namespace Minim
+{
+	NullAudioOut::NullAudioOut( const AudioFormat & format, const int bufferSize )
+	: OfflineAudioOut( format, bufferSize )
+	, mRunning( false )
+	, mBufferCount( 0 )
+	, mDeadlineMisses( 0 )
+	, mMaxRenderMicroseconds( 0 )
+	, mTotalRenderMicroseconds( 0 )
+	, mRingOverflows( 0 )
+	, mRingWrite( 0 )
+	, mRingRead( 0 )
+	{
+	}
+	
+	NullAudioOut::~NullAudioOut()
+	{
+		close();
+	}
+	
+	void NullAudioOut::setRingBufferSize( const int numFrames )
+	{
+		mRing.assign( numFrames > 0 ? numFrames * getFormat().getChannels() : 0, 0.f );
+		mRingWrite.store( 0 );
+		mRingRead.store( 0 );
+	}
+	
+	void NullAudioOut::resetStatistics()
+	{
+		mBufferCount.store( 0 );
+		mDeadlineMisses.store( 0 );
+		mMaxRenderMicroseconds.store( 0 );
+		mTotalRenderMicroseconds.store( 0 );
+		mRingOverflows.store( 0 );
+	}
+	
+	void NullAudioOut::open()
+	{
+		if ( !mRunning.load() )
+		{
+			mRunning.store( true );
+			mThread = std::thread( &NullAudioOut::run, this );
+		}
+	}
+	
+	void NullAudioOut::close()
+	{
+		if ( mRunning.exchange( false ) )
+		{
+			mThread.join();
+		}
+	}
+	
+	void NullAudioOut::run()
+	{
+		typedef std::chrono::steady_clock Clock;
+		
+		const int bufferFrames = bufferSize();
+		const Clock::duration bufferDuration = std::chrono::duration_cast<Clock::duration>( 
+			std::chrono::duration<double>( (double)bufferFrames / getFormat().getSampleRate() ) );
+		
+		// when the buffer we are about to generate would start playing
+		Clock::time_point deadline = Clock::now();
+		while ( mRunning.load() )
+		{
+			std::this_thread::sleep_until( deadline );
+			
+			const Clock::time_point start = Clock::now();
+			renderBlock( bufferFrames );
+			const Clock::time_point end = Clock::now();
+			
+			if ( !mRing.empty() )
+			{
+				writeRingBuffer( getOutputBuffer() );
+			}
+			
+			const long micros = (long)std::chrono::duration_cast<std::chrono::microseconds>( end - start ).count();
+			mTotalRenderMicroseconds += micros;
+			if ( micros > mMaxRenderMicroseconds.load() )
+			{
+				mMaxRenderMicroseconds.store( micros );
+			}
+			++mBufferCount;
+			
+			// a device would have needed this buffer by the time the previous one finished playing
+			deadline += bufferDuration;
+			if ( end > deadline )
+			{
+				++mDeadlineMisses;
+				
+				// don't try to make up for lost time, a device wouldn't wait for us either
+				if ( end > deadline + bufferDuration )
+				{
+					deadline = end;
+				}
+			}
+		}
+	}
+	
+	void NullAudioOut::writeRingBuffer( const MultiChannelBuffer & buffer )
+	{
+		const size_t capacity = mRing.size();
+		const int channels	  = buffer.getChannelCount();
+		const int frames	  = buffer.getBufferSize();
+		
+		size_t write	 = mRingWrite.load();
+		const size_t read = mRingRead.load();
+		for( int i = 0; i < frames; ++i )
+		{
+			if ( write - read + channels > capacity )
+			{
+				mRingOverflows += frames - i;
+				break;
+			}
+			
+			for( int c = 0; c < channels; ++c )
+			{
+				mRing[ (write + c) % capacity ] = buffer.getSample( c, i );
+			}
+			write += channels;
+		}
+		
+		mRingWrite.store( write );
+	}
+	
+	int NullAudioOut::readRingBuffer( float * interleaved, const int maxFrames )
+	{
+		const size_t capacity = mRing.size();
+		if ( capacity == 0 )
+		{
+			return 0;
+		}
+		
+		const int channels	= getFormat().getChannels();
+		const size_t write	= mRingWrite.load();
+		size_t read			= mRingRead.load();
+		
+		int frames = (int)((write - read) / channels);
+		if ( frames > maxFrames )
+		{
+			frames = maxFrames;
+		}
+		
+		const size_t samples = (size_t)frames * channels;
+		for( size_t s = 0; s < samples; ++s )
+		{
+			interleaved[s] = mRing[ (read + s) % capacity ];
+		}
+		
+		mRingRead.store( read + samples );
+		return frames;
+	}
+}
@@ -0,0 +1,95 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef NULLAUDIOOUT_H
+#define NULLAUDIOOUT_H
+
+#include "OfflineAudioOut.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace Minim
+{
+	/**
+	 * An AudioOut that behaves like an audio device without needing one. Once opened, it reads 
+	 * a buffer from its stream on its own thread every bufferSize / sampleRate seconds, just like 
+	 * a device callback would. That makes it possible to run the real-time path on a server 
+	 * with no sound card, for load and soak tests.
+	 *
+	 * A buffer that takes longer to generate than it would take to play counts as a deadline miss, 
+	 * which is where a real device would have glitched. If we fall more than a buffer behind, 
+	 * the clock starts over from now rather than rushing to catch up.
+	 *
+	 * What is generated goes to our listener as usual, so adding a SampleRecorder to the 
+	 * AudioOutput writes it to a file. It can also be copied into a ring buffer for another 
+	 * thread to read, see setRingBufferSize.
+	 */
+	class NullAudioOut : public OfflineAudioOut
+	{
+	public:
+		NullAudioOut( const AudioFormat & format, const int bufferSize );
+		virtual ~NullAudioOut();
+		
+		// keep the last numFrames sample frames we generated around for readRingBuffer.
+		// 0 turns the ring buffer off, which is the default. call this before open.
+		void setRingBufferSize( const int numFrames );
+		
+		// copy up to maxFrames interleaved sample frames out of the ring buffer, returns how many were copied.
+		// only one thread should read at a time.
+		int readRingBuffer( float * interleaved, const int maxFrames );
+		
+		// statistics, these are safe to call from any thread while running.
+		inline long getBufferCount() const { return mBufferCount.load(); }
+		inline long getDeadlineMisses() const { return mDeadlineMisses.load(); }
+		// how long the slowest buffer took to generate
+		inline long getMaxRenderMicroseconds() const { return mMaxRenderMicroseconds.load(); }
+		// how long all buffers took to generate, divide by the time we've been running to get a load
+		inline long long getTotalRenderMicroseconds() const { return mTotalRenderMicroseconds.load(); }
+		// frames that didn't fit in the ring buffer because nobody read them in time
+		inline long getRingBufferOverflows() const { return mRingOverflows.load(); }
+		void resetStatistics();
+		
+		// AudioResource overrides, open starts our thread and close stops it.
+		virtual void open();
+		virtual void close();
+		
+	private:
+		
+		void run();
+		
+		void writeRingBuffer( const MultiChannelBuffer & buffer );
+		
+		std::thread					mThread;
+		std::atomic<bool>			mRunning;
+		
+		std::atomic<long>			mBufferCount;
+		std::atomic<long>			mDeadlineMisses;
+		std::atomic<long>			mMaxRenderMicroseconds;
+		std::atomic<long long>		mTotalRenderMicroseconds;
+		std::atomic<long>			mRingOverflows;
+		
+		// single producer, single consumer. positions are in samples and only ever increase.
+		std::vector<float>			mRing;
+		std::atomic<size_t>			mRingWrite;
+		std::atomic<size_t>			mRingRead;
+	};
+}
+
+#endif // NULLAUDIOOUT_H
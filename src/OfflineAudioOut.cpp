@@ -0,0 +1,101 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "OfflineAudioOut.h"
+#include "AudioStream.h"
+#include "AudioListener.h"
+
+#include <stdio.h> // for sprintf
+#include <string.h> // for memcpy
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+namespace Minim
+{
+	OfflineAudioOut::OfflineAudioOut( const AudioFormat & format, const int blockSize )
+	: mFormat( format )
+	, mBuffer( format.getChannels(), blockSize )
+	, mBlockSize( blockSize )
+	, mStream( NULL )
+	, mListener( NULL )
+	, mPaused( false )
+	, mFramesRendered( 0 )
+	{
+		char desc[128];
+		sprintf( desc, "Offline render at %d Hz with block size %d", (int)format.getSampleRate(), blockSize );
+		mDescription = desc;
+	}
+	
+	OfflineAudioOut::~OfflineAudioOut()
+	{
+	}
+	
+	void OfflineAudioOut::render( const long numFrames )
+	{
+		long framesLeft = numFrames;
+		while ( framesLeft > 0 )
+		{
+			const int frames = framesLeft < mBlockSize ? (int)framesLeft : mBlockSize;
+			renderBlock( frames );
+			framesLeft -= frames;
+		}
+	}
+	
+	void OfflineAudioOut::render( MultiChannelBuffer & buffer )
+	{
+		const int channels  = buffer.getChannelCount() < mFormat.getChannels() ? buffer.getChannelCount() : mFormat.getChannels();
+		const int numFrames = buffer.getBufferSize();
+		int frame = 0;
+		while ( frame < numFrames )
+		{
+			const int frames = numFrames - frame < mBlockSize ? numFrames - frame : mBlockSize;
+			renderBlock( frames );
+			
+			for( int c = 0; c < channels; ++c )
+			{
+				memcpy( buffer.getChannel(c) + frame, mBuffer.getChannel(c), sizeof(float)*frames );
+			}
+			
+			frame += frames;
+		}
+	}
+	
+	void OfflineAudioOut::renderBlock( const int numFrames )
+	{
+		// mBuffer keeps room for a whole block, this only changes how much of it the stream fills
+		mBuffer.setBufferSize( numFrames );
+		
+		if ( mStream && !mPaused )
+		{
+			mStream->read( mBuffer );
+		}
+		else
+		{
+			mBuffer.makeSilence();
+		}
+		
+		if ( mListener )
+		{
+			mListener->samples( mBuffer );
+		}
+		
+		mFramesRendered += numFrames;
+	}
+}
@@ -0,0 +1,98 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef OFFLINEAUDIOOUT_H
+#define OFFLINEAUDIOOUT_H
+
+#include "AudioOut.h"
+#include "AudioFormat.h"
+#include "MultiChannelBuffer.h"
+
+#include <string>
+
+namespace Minim
+{
+	/**
+	 * An AudioOut that isn't connected to an audio device. Nothing is generated until you
+	 * call render, which reads from the stream as fast as it can, one block at a time. 
+	 * Give one to an AudioOutput to render the same UGens and notes you'd play live into 
+	 * a MultiChannelBuffer, or to a file by adding a SampleRecorder as a listener:
+	 *
+	 * <pre>
+	 * OfflineAudioOut * offline = new OfflineAudioOut( AudioFormat(44100, 2), 1024 );
+	 * AudioOutput out( offline ); // out deletes offline
+	 * SampleRecorder * rec = system.createRecorder( &out, "render.wav", false );
+	 * out.addListener( rec );
+	 * rec->beginRecord();
+	 * offline->render( 60 * 44100 );
+	 * rec->save();
+	 * </pre>
+	 *
+	 * Rendering happens on whatever thread calls render, so it's fine to patch between renders.
+	 */
+	class OfflineAudioOut : public AudioOut
+	{
+	public:
+		// blockSize is how many sample frames are read from the stream at a time.
+		OfflineAudioOut( const AudioFormat & format, const int blockSize );
+		virtual ~OfflineAudioOut();
+		
+		// render numFrames sample frames. the output only goes to our listener.
+		void render( const long numFrames );
+		
+		// render enough sample frames to fill buffer, which should have as many channels as our format.
+		// each block also goes to our listener.
+		void render( MultiChannelBuffer & buffer );
+		
+		// how many sample frames we've rendered in total
+		inline long getFramesRendered() const { return mFramesRendered; }
+		
+		// AudioOut implementation
+		virtual int bufferSize() const { return mBlockSize; }
+		virtual void setAudioStream( AudioStream * stream ) { mStream = stream; }
+		virtual void setAudioListener( AudioListener * listen ) { mListener = listen; }
+		virtual const MultiChannelBuffer & getOutputBuffer() const { return mBuffer; }
+		// while paused, render generates silence without reading from the stream
+		virtual void pauseProcessing() { mPaused = true; }
+		virtual void resumeProcessing() { mPaused = false; }
+		
+		// AudioResource implementation
+		virtual void open() {}
+		virtual void close() {}
+		virtual const AudioFormat & getFormat() const { return mFormat; }
+		virtual const char * getDescription() const { return mDescription.c_str(); }
+		
+	protected:
+		
+		// read the next numFrames from the stream into our buffer and pass it to our listener.
+		// numFrames must be no more than our block size.
+		void renderBlock( const int numFrames );
+		
+	private:
+		AudioFormat			mFormat;
+		MultiChannelBuffer	mBuffer;
+		int					mBlockSize;
+		AudioStream *		mStream;
+		AudioListener *		mListener;
+		bool				mPaused;
+		long				mFramesRendered;
+		std::string			mDescription;
+	};
+}
+
+#endif // OFFLINEAUDIOOUT_H
@@ -0,0 +1,223 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "RenderThreadPool.h"
+#include "Logging.h"
+
+#include <chrono>
+
+#ifdef WINDOWS
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+namespace Minim
+{
+	// how long a worker spins after a block before it goes to sleep
+	static const int kSpinMicroseconds = 10;
+	
+	// schedule the calling thread the way the audio thread is.
+	// this is best effort, it will fail without the right privileges and we carry on regardless.
+	static void setPriority( const int priority )
+	{
+#ifdef WINDOWS
+		if ( priority != 0 && !SetThreadPriority( GetCurrentThread(), priority ) )
+		{
+			Minim::debug("RenderThreadPool: couldn't set worker thread priority.");
+		}
+#else
+		if ( priority > 0 )
+		{
+			sched_param param;
+			param.sched_priority = priority;
+			if ( pthread_setschedparam( pthread_self(), SCHED_FIFO, &param ) != 0 )
+			{
+				Minim::debug("RenderThreadPool: couldn't make worker thread real-time.");
+			}
+		}
+#endif
+	}
+	
+	RenderThreadPool::RenderThreadPool( const int numThreads, const int priority )
+	: mRanges(NULL)
+	, mRangeCount( numThreads > 0 ? numThreads + 1 : 1 )
+	, mFunction(NULL)
+	, mUserData(NULL)
+	, mGeneration(0)
+	, mRemaining(0)
+	, mQuit(false)
+	, mSleepers(0)
+	{
+		mRanges = new std::atomic<unsigned long long>[mRangeCount];
+		for( int i = 0; i < mRangeCount; ++i )
+		{
+			mRanges[i].store( 0 );
+		}
+		
+		for( int i = 1; i < mRangeCount; ++i )
+		{
+			mThreads.push_back( std::thread( &RenderThreadPool::workerLoop, this, i, priority ) );
+		}
+	}
+	
+	RenderThreadPool::~RenderThreadPool()
+	{
+		mQuit.store( true );
+		{
+			std::lock_guard<std::mutex> lock( mSleepMutex );
+			mWake.notify_all();
+		}
+		
+		for( size_t i = 0; i < mThreads.size(); ++i )
+		{
+			mThreads[i].join();
+		}
+		
+		delete [] mRanges;
+	}
+	
+	///////////////////////////////////////////////////
+	void RenderThreadPool::run( TaskFunction func, void * userData, const int taskCount )
+	{
+		if ( mThreads.empty() || taskCount == 1 )
+		{
+			for( int i = 0; i < taskCount; ++i )
+			{
+				func( userData, i );
+			}
+			return;
+		}
+		
+		// anything past what we can pack in a range, we just do ourselves
+		const int pooled = taskCount < kMaxTasks ? taskCount : kMaxTasks;
+		
+		mFunction = func;
+		mUserData = userData;
+		mRemaining.store( pooled );
+		
+		const unsigned int generation = mGeneration.load() + 1;
+		for( int p = 0; p < mRangeCount; ++p )
+		{
+			const int begin = (int)((long long)pooled * p / mRangeCount);
+			const int end   = (int)((long long)pooled * (p+1) / mRangeCount);
+			mRanges[p].store( pack( generation, begin, end ) );
+		}
+		
+		// this is what lets the workers go
+		mGeneration.store( generation );
+		
+		if ( mSleepers.load() > 0 )
+		{
+			// not taking the lock because we don't want to block the audio thread.
+			// a worker that misses this will wake up on its own shortly.
+			mWake.notify_all();
+		}
+		
+		work( generation, 0 );
+		
+		for( int i = pooled; i < taskCount; ++i )
+		{
+			func( userData, i );
+		}
+		
+		// wait for tasks other threads are still finishing
+		while ( mRemaining.load() > 0 )
+		{
+			std::this_thread::yield();
+		}
+	}
+	
+	///////////////////////////////////////////////////
+	void RenderThreadPool::work( const unsigned int generation, const int participant )
+	{
+		// our own range first, then everyone else's
+		for( int i = 0; i < mRangeCount; ++i )
+		{
+			const int p = (participant + i) % mRangeCount;
+			int task = 0;
+			while ( take( generation, p, task ) )
+			{
+				// safe to read these because run can't return, and change them,
+				// until we finish the task we just took.
+				mFunction( mUserData, task );
+				--mRemaining;
+			}
+		}
+	}
+	
+	///////////////////////////////////////////////////
+	bool RenderThreadPool::take( const unsigned int generation, const int participant, int & task )
+	{
+		unsigned long long range = mRanges[participant].load();
+		for(;;)
+		{
+			const unsigned int rangeGeneration = (unsigned int)(range >> 32);
+			const int next = (int)((range >> 16) & 0xFFFF);
+			const int end  = (int)(range & 0xFFFF);
+			if ( rangeGeneration != generation || next >= end )
+			{
+				return false;
+			}
+			
+			if ( mRanges[participant].compare_exchange_weak( range, pack( generation, next + 1, end ) ) )
+			{
+				task = next;
+				return true;
+			}
+		}
+	}
+	
+	///////////////////////////////////////////////////
+	void RenderThreadPool::workerLoop( const int participant, const int priority )
+	{
+		setPriority( priority );
+		
+		unsigned int seen = mGeneration.load();
+		while ( !mQuit.load() )
+		{
+			// spin for a moment, because the audio thread may start another run right away
+			unsigned int generation = mGeneration.load();
+			const std::chrono::steady_clock::time_point spinUntil = std::chrono::steady_clock::now() + std::chrono::microseconds(kSpinMicroseconds);
+			while ( generation == seen && std::chrono::steady_clock::now() < spinUntil )
+			{
+				generation = mGeneration.load();
+			}
+			
+			// then sleep until woken, checking now and then in case we missed it
+			if ( generation == seen )
+			{
+				std::unique_lock<std::mutex> lock( mSleepMutex );
+				++mSleepers;
+				while ( mGeneration.load() == seen && !mQuit.load() )
+				{
+					mWake.wait_for( lock, std::chrono::milliseconds(5) );
+				}
+				--mSleepers;
+				generation = mGeneration.load();
+			}
+			
+			if ( generation != seen )
+			{
+				seen = generation;
+				work( generation, participant );
+			}
+		}
+	}
+}
@@ -0,0 +1,102 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef RENDERTHREADPOOL_H
+#define RENDERTHREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Minim
+{
+	/**
+	 * A pool of worker threads that help the audio thread get through a list of independent 
+	 * tasks. The tasks are split evenly between the calling thread and the workers up front, 
+	 * and anyone who runs out of their own tasks steals tasks from the others, so one 
+	 * expensive task doesn't leave everyone else waiting on whoever got it.
+	 *
+	 * Workers run at the priority they are given, which should be no higher than the 
+	 * audio thread's so that they can't keep it from running. After each block they spin 
+	 * for a few microseconds, in case the audio thread has more work right away, and then 
+	 * sleep until the next block starts so they don't burn a core while the audio thread waits.
+	 */
+	class RenderThreadPool
+	{
+	public:
+		// what runs a task. userData is whatever was passed to run.
+		typedef void (*TaskFunction)( void * userData, const int task );
+		
+		// numThreads is how many threads to start in addition to the thread that calls run.
+		// priority is what the workers are scheduled at, normally that of the audio thread: 
+		// a SCHED_FIFO priority on POSIX systems, where 0 leaves them at the default scheduling, 
+		// or a SetThreadPriority level on Windows, where 0 is THREAD_PRIORITY_NORMAL.
+		explicit RenderThreadPool( const int numThreads, const int priority = 0 );
+		~RenderThreadPool();
+		
+		// how many worker threads we have, not including the thread that calls run.
+		inline int getThreadCount() const { return (int)mThreads.size(); }
+		
+		// runs func for every task in [0, taskCount) and returns once all of them have finished.
+		// the calling thread works on tasks too. there is no guarantee about which thread runs 
+		// a task or in what order, so tasks should not depend on each other.
+		void run( TaskFunction func, void * userData, const int taskCount );
+		
+	private:
+		
+		void workerLoop( const int participant, const int priority );
+		
+		// run tasks until there are none left in any range of this generation
+		void work( const unsigned int generation, const int participant );
+		
+		// claim the next task from the range of participant if there is one left in this generation
+		bool take( const unsigned int generation, const int participant, int & task );
+		
+		// a range is packed as generation in the top 32 bits, then next task, then end of the range.
+		// this way a worker that wakes up late can't take tasks from a block it didn't see start.
+		static inline unsigned long long pack( const unsigned int generation, const int next, const int end )
+		{
+			return ((unsigned long long)generation << 32) | ((unsigned long long)(next & 0xFFFF) << 16) | (unsigned long long)(end & 0xFFFF);
+		}
+		
+		// tasks per run are limited to what fits in the range
+		static const int kMaxTasks = 0xFFFF;
+		
+		std::vector<std::thread>		mThreads;
+		
+		// one range per participant, index 0 is the thread that calls run
+		std::atomic<unsigned long long> * mRanges;
+		int								  mRangeCount;
+		
+		TaskFunction					mFunction;
+		void *							mUserData;
+		
+		std::atomic<unsigned int>		mGeneration;
+		std::atomic<int>				mRemaining;
+		std::atomic<bool>				mQuit;
+		
+		// for workers that have been idle long enough to sleep
+		std::mutex						mSleepMutex;
+		std::condition_variable			mWake;
+		std::atomic<int>				mSleepers;
+	};
+}
+
+#endif // RENDERTHREADPOOL_H
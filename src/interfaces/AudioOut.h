@@ -31,7 +31,7 @@ namespace Minim
 	  /**
 	   * @return the size of the buffer used by this output.
 	   */
-	  virtual const int bufferSize() const = 0;
+	  virtual int bufferSize() const = 0;
 	  
 	  /**
 	   * Sets the AudioStream that this output will read from to 
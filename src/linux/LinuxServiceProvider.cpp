@@ -0,0 +1,210 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "Logging.h"
+#include "LinuxServiceProvider.h"
+#include "libsndAudioRecordingStream.h"
+#include "mpg123AudioRecordingStream.h"
+#include "libsndSampleRecorder.h"
+#include "RtAudioOut.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h> // for strcasecmp
+#include <sys/mman.h>
+
+#if defined(__SSE__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+namespace Minim
+{
+
+	LinuxServiceProvider::LinuxServiceProvider()
+	: mMemoryLocked(false)
+	{
+	}
+	
+	LinuxServiceProvider::LinuxServiceProvider( const RealTimeParameters & parameters )
+	: mParameters(parameters)
+	, mMemoryLocked(false)
+	{
+	}
+
+	LinuxServiceProvider::~LinuxServiceProvider()
+	{
+	}
+	  
+	void LinuxServiceProvider::start()
+	{
+		// intialize mp3 decoding library
+		if ( int err = mpg123_init() )
+		{
+			char msg[256];
+			sprintf( msg, "mpg123 initialization failed with error: %s\n", mpg123_plain_strerror(err) );
+			Minim::error( msg );
+		}
+		
+		if ( mParameters.lockMemory )
+		{
+			if ( mlockall( MCL_CURRENT | MCL_FUTURE ) == 0 )
+			{
+				mMemoryLocked = true;
+				mMemoryReport = "memory locked";
+			}
+			else
+			{
+				mMemoryReport  = "mlockall failed: ";
+				mMemoryReport += strerror( errno );
+			}
+		}
+	}
+
+	void LinuxServiceProvider::stop()
+	{
+		mpg123_exit();
+		
+		if ( mMemoryLocked )
+		{
+			munlockall();
+			mMemoryLocked = false;
+		}
+	}
+	  
+	void LinuxServiceProvider::debugOn()
+	{
+	}
+
+	void LinuxServiceProvider::debugOff()
+	{
+	}
+	  
+	AudioRecordingStream * LinuxServiceProvider::getAudioRecordingStream( const char * filename, int bufferSize, bool inMemory )
+	{
+		size_t len = strlen(filename);
+		if ( len >= 4 && strcasecmp(".mp3", filename + (len-4)) == 0 )
+		{
+			return new mpg123AudioRecordingStream( filename, bufferSize );
+		}
+		return new libsndAudioRecordingStream( filename, bufferSize );
+	}
+
+	AudioStream * LinuxServiceProvider::getAudioInput( const AudioFormat & inputFormat )
+	{
+		return NULL;
+	}
+
+	AudioOut * LinuxServiceProvider::getAudioOutput( const AudioFormat & outputFormat, int outputBufferSize )
+	{
+		RtAudioOut * out = new RtAudioOut( outputFormat, outputBufferSize );
+		out->setThreadSetup( &LinuxServiceProvider::setupRenderThread, this );
+		return out;
+	}
+
+	AudioSample * LinuxServiceProvider::getAudioSample( const char * filename, int bufferSize )
+	{
+		return NULL;
+	}
+
+	AudioSample * LinuxServiceProvider::getAudioSample( MultiChannelBuffer * samples, const AudioFormat & format, int bufferSize )
+	{
+		return NULL;
+	}
+
+	SampleRecorder * LinuxServiceProvider::getSampleRecorder( AudioSource * sourceToRecord, const char * saveTo, const bool buffered )
+	{
+		return new libsndSampleRecorder( sourceToRecord, saveTo );
+	}
+	
+	// adds text to the end of a thread setup report, separated from what's already there by a comma
+	static void appendReport( char * report, const size_t reportSize, const char * text )
+	{
+		const size_t length = strlen( report );
+		snprintf( report + length, reportSize - length, "%s%s", length > 0 ? ", " : "", text );
+	}
+	
+	void LinuxServiceProvider::setupRenderThread( void * userData, char * report, const size_t reportSize )
+	{
+		const LinuxServiceProvider & provider = *static_cast<LinuxServiceProvider*>(userData);
+		const RealTimeParameters & params = provider.mParameters;
+		char msg[128];
+		
+		if ( params.priority > 0 )
+		{
+			sched_param param;
+			param.sched_priority = params.priority;
+			const int err = pthread_setschedparam( pthread_self(), SCHED_FIFO, &param );
+			if ( err == 0 )
+			{
+				snprintf( msg, sizeof(msg), "SCHED_FIFO priority %d", params.priority );
+			}
+			else
+			{
+				snprintf( msg, sizeof(msg), "SCHED_FIFO failed: %s", strerror(err) );
+			}
+			appendReport( report, reportSize, msg );
+		}
+		
+		if ( params.cpu >= 0 )
+		{
+			cpu_set_t cpus;
+			CPU_ZERO( &cpus );
+			CPU_SET( params.cpu, &cpus );
+			const int err = pthread_setaffinity_np( pthread_self(), sizeof(cpu_set_t), &cpus );
+			if ( err == 0 )
+			{
+				snprintf( msg, sizeof(msg), "pinned to CPU %d", params.cpu );
+			}
+			else
+			{
+				snprintf( msg, sizeof(msg), "pinning to CPU %d failed: %s", params.cpu, strerror(err) );
+			}
+			appendReport( report, reportSize, msg );
+		}
+		
+		if ( params.flushDenormals )
+		{
+#if defined(__SSE__) || defined(__x86_64__)
+			// flush to zero (bit 15) and denormals are zero (bit 6)
+			_mm_setcsr( _mm_getcsr() | 0x8040 );
+			appendReport( report, reportSize, "FTZ/DAZ on" );
+#elif defined(__aarch64__)
+			// flush to zero is bit 24 of the FPCR
+			unsigned long fpcr = 0;
+			__asm__ __volatile__( "mrs %0, fpcr" : "=r"(fpcr) );
+			fpcr |= (1UL << 24);
+			__asm__ __volatile__( "msr fpcr, %0" : : "r"(fpcr) );
+			appendReport( report, reportSize, "FZ on" );
+#else
+			appendReport( report, reportSize, "denormal flushing not supported on this CPU" );
+#endif
+		}
+		
+		if ( !provider.mMemoryReport.empty() )
+		{
+			appendReport( report, reportSize, provider.mMemoryReport.c_str() );
+		}
+	}
+}
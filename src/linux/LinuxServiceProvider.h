@@ -0,0 +1,91 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef LINUXSERVICEPROVIDER_H
+#define LINUXSERVICEPROVIDER_H
+
+#include "ServiceProvider.h"
+
+#include <string>
+
+namespace Minim
+{
+	/**
+	 * ServiceProvider for Linux. Files are streamed with libsndfile and mpg123, output goes 
+	 * through RtAudio, and recording uses libsndfile, the same as on Windows.
+	 *
+	 * Because Linux won't treat the audio thread specially unless asked, the thread RtAudio
+	 * renders on is configured before it renders its first buffer: SCHED_FIFO priority, 
+	 * optionally pinned to a CPU, and with denormals flushed to zero. Memory is locked with 
+	 * mlockall when the provider starts so that rendering doesn't page fault. All of these 
+	 * are best effort (SCHED_FIFO and mlockall usually need rtprio and memlock limits set for 
+	 * the user) and what actually happened is reported in the description of each output.
+	 */
+	class LinuxServiceProvider : public ServiceProvider
+	{
+	public:
+		struct RealTimeParameters
+		{
+			RealTimeParameters()
+			: priority(70)
+			, cpu(-1)
+			, lockMemory(true)
+			, flushDenormals(true)
+			{
+			}
+			
+			// SCHED_FIFO priority of the audio thread, 0 leaves the scheduling alone.
+			int  priority;
+			// which CPU to pin the audio thread to, -1 doesn't pin it.
+			int  cpu;
+			// mlockall when we start
+			bool lockMemory;
+			// set FTZ/DAZ (or FZ on ARM) on the audio thread
+			bool flushDenormals;
+		};
+		
+		LinuxServiceProvider();
+		LinuxServiceProvider( const RealTimeParameters & parameters );
+		virtual ~LinuxServiceProvider();
+		
+		virtual void start();
+		virtual void stop();
+		
+		virtual void debugOn();
+		virtual void debugOff();
+		
+		virtual AudioRecordingStream * getAudioRecordingStream( const char * filename, int bufferSize, bool inMemory );
+		virtual AudioStream * getAudioInput( const AudioFormat & inputFormat );
+		virtual AudioOut * getAudioOutput( const AudioFormat & outputFormat, int outputBufferSize );
+		virtual AudioSample * getAudioSample( const char * filename, int bufferSize );
+		virtual AudioSample * getAudioSample( MultiChannelBuffer * samples, const AudioFormat & format, int bufferSize );
+		virtual SampleRecorder * getSampleRecorder( AudioSource * sourceToRecord, const char * saveTo, const bool buffered );
+		
+	private:
+		
+		// RtAudioOut::ThreadSetupFunction, userData is the provider
+		static void setupRenderThread( void * userData, char * report, const size_t reportSize );
+		
+		RealTimeParameters mParameters;
+		// what happened when we tried to lock memory
+		std::string		   mMemoryReport;
+		bool			   mMemoryLocked;
+	};
+}
+
+#endif // LINUXSERVICEPROVIDER_H
@@ -26,7 +26,7 @@ public:
     virtual const char * getDescription() const { return "CoreAudio RemoteIO"; }
 	
 	// AudioOut implementation
-	virtual const int bufferSize() const { return mBuffer.getBufferSize(); }
+	virtual int bufferSize() const { return mBuffer.getBufferSize(); }
 	
 	virtual void setAudioStream( Minim::AudioStream * stream );
 	virtual void setAudioListener( Minim::AudioListener * listen );
@@ -52,6 +52,11 @@ void Minim::ADSR::noteOn()
     
     timeFromOff = -1;
     isTurnedOff = false;
+    
+    // a release that was cut off by this note shouldn't unpatch us when this one ends
+    bUnpatchAfterRelease = false;
+    outputToUnpatch      = NULL;
+    ugenOutputToUnpatch  = NULL;
 
 	amplitude = beforeAmplitude;
 }
@@ -77,6 +82,20 @@ void Minim::ADSR::unpatchAfterRelease( Minim::UGen* from )
     ugenOutputToUnpatch  = from; 
 }
 
+//-----------------------------
+float Minim::ADSR::getAmplitude() const
+{
+    if ( !isTurnedOn )
+    {
+        return beforeAmplitude;
+    }
+    if ( timeFromOff > releaseTime )
+    {
+        return afterAmplitude;
+    }
+    return amplitude;
+}
+
 //-----------------------------
 void Minim::ADSR::uGenerate( float* channels, const int numChannels )
 {
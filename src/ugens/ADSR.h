@@ -36,6 +36,11 @@ namespace Minim
         void unpatchAfterRelease( AudioOutput* from );
         void unpatchAfterRelease( UGen* from );
         
+        // true from noteOn until the release has finished
+        bool isPlaying() const { return isTurnedOn && !( isTurnedOff && timeFromOff > releaseTime ); }
+        // the amplitude the envelope is applying to the audio right now
+        float getAmplitude() const;
+        
     protected:
         
         virtual void sampleRateChanged()
@@ -0,0 +1,141 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "BandLimitedWavetable.h"
+#include "Logging.h"
+
+#define  _USE_MATH_DEFINES // required in windows to get constants like M_PI
+#include <math.h>
+#include <stdio.h> // for snprintf
+#include <cstring> // for memset, memcpy
+#include <vector>
+
+namespace Minim
+{
+	// a period of four samples is the least that has room for the fundamental
+	static const int kMinTableSize = 5;
+
+	static int validTableSize( const int tableSize )
+	{
+		if ( tableSize < kMinTableSize )
+		{
+			char msg[128];
+			snprintf( msg, sizeof(msg), "BandLimitedWavetable: tableSize %d is too small, using %d.", tableSize, kMinTableSize );
+			Minim::error( msg );
+			return kMinTableSize;
+		}
+		return tableSize;
+	}
+
+	BandLimitedWavetable::BandLimitedWavetable( const float * amps, const int nAmps, const int tableSize )
+	: mTables( NULL )
+	, mSize( validTableSize( tableSize ) )
+	, mSizeForLookup( (float)mSize - 1 )
+	, mLevelCount( 1 )
+	, mHarmonicCount( 0 )
+	{
+		// like the other wavetables the last sample is the same as the first,
+		// so a period is one sample shorter than the table. we keep the harmonics
+		// to a quarter of that so linear interpolation doesn't dull the top ones too much.
+		const int period = mSize - 1;
+		mHarmonicCount = period / 4 < nAmps ? period / 4 : nAmps;
+		if ( mHarmonicCount < 1 )
+		{
+			mHarmonicCount = 1;
+		}
+		while ( ( mHarmonicCount >> mLevelCount ) > 0 )
+		{
+			++mLevelCount;
+		}
+
+		mTables = new float[ mLevelCount * mSize ];
+
+		// one period of a sine, so every harmonic is a lookup
+		std::vector<float> sine( period );
+		for( int i = 0; i < period; ++i )
+		{
+			sine[i] = (float)sin( 2 * M_PI * i / period );
+		}
+
+		// build from the level with the fewest harmonics up, so each level
+		// only has to add the harmonics the one after it doesn't have.
+		std::vector<float> sum( mSize, 0.f );
+		int harmonic = 0;
+		for( int level = mLevelCount - 1; level >= 0; --level )
+		{
+			const int count = mHarmonicCount >> level;
+			for( ; harmonic < count && harmonic < nAmps; ++harmonic )
+			{
+				const float amp = amps[harmonic];
+				if ( amp == 0.f )
+				{
+					continue;
+				}
+
+				const int step = harmonic + 1;
+				int index = 0;
+				for( int i = 0; i < mSize; ++i )
+				{
+					sum[i] += amp * sine[index];
+					index += step;
+					if ( index >= period )
+					{
+						index -= period;
+					}
+				}
+			}
+
+			memcpy( mTables + level * mSize, &sum[0], sizeof(float) * mSize );
+		}
+	}
+
+	BandLimitedWavetable::~BandLimitedWavetable()
+	{
+		delete [] mTables;
+	}
+
+	//////////////////////////////////////////////
+	float BandLimitedWavetable::value( const float at ) const
+	{
+		return lookup( 0, at );
+	}
+
+	//////////////////////////////////////////////
+	float BandLimitedWavetable::value( const float at, const float step ) const
+	{
+		// level n has no harmonics above Nyquist for steps up to 0.5 * 2^n / mHarmonicCount,
+		// so how far we are along x tells us which two levels to use: it is in
+		// [ 2^lo, 2^(lo+1) ) and we fade from lo to lo+1 as it goes from one end to the other.
+		const float x = fabsf( step ) * 4.f * mHarmonicCount;
+		if ( x < 1.f )
+		{
+			return lookup( 0, at );
+		}
+
+		int exponent;
+		const float mantissa = frexpf( x, &exponent );
+		const int	lo		 = exponent - 1;
+		if ( lo >= mLevelCount - 1 )
+		{
+			return lookup( mLevelCount - 1, at );
+		}
+
+		const float fade = 2.f * mantissa - 1.f;
+		return lookup( lo, at ) * ( 1.f - fade ) + lookup( lo + 1, at ) * fade;
+	}
+}
@@ -0,0 +1,79 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef BANDLIMITEDWAVETABLE_H
+#define BANDLIMITEDWAVETABLE_H
+
+#include "Waveform.h"
+
+namespace Minim
+{
+	/**
+	 * A waveform built from sine harmonics, like Waves::gen10, that doesn't alias when
+	 * an Oscil plays it at high frequencies. It keeps one table per octave, each with
+	 * half the harmonics of the one before, all made up front. When it is asked for a value
+	 * at a given step size it crossfades between the two tables that have no harmonics above
+	 * Nyquist at that step size, so it costs two table lookups no matter the frequency.
+	 *
+	 * Going up an octave the sound fades from the brighter table to the duller one,
+	 * so near the top of an octave it has up to half as many harmonics as it could.
+	 * That's the price of never aliasing.
+	 *
+	 * See Waves::sawbl, squarebl, and trianglebl for the usual shapes.
+	 */
+	class BandLimitedWavetable : public Waveform
+	{
+	public:
+		// amps are the amplitudes of the harmonics, amps[0] being the fundamental, as for gen10.
+		// harmonics that don't fit in tables of tableSize samples are left out.
+		// tables have at least 5 samples, smaller sizes are reported with Minim::error.
+		BandLimitedWavetable( const float * amps, const int nAmps, const int tableSize );
+		virtual ~BandLimitedWavetable();
+
+		// Waveform impl: at should be between 0 and 1. without a step this is the full waveform.
+		virtual float value( const float at ) const;
+		virtual float value( const float at, const float step ) const;
+
+		inline int size() const { return mSize; }
+		inline int getLevelCount() const { return mLevelCount; }
+		// how many harmonics the table for level has, level 0 having the most
+		inline int getHarmonicCount( const int level ) const { return mHarmonicCount >> level; }
+		inline const float * getLevel( const int level ) const { return mTables + level * mSize; }
+
+	private:
+		inline float lookup( const int level, const float at ) const
+		{
+			const float * table = mTables + level * mSize;
+			const float whichSample = mSizeForLookup * at;
+			const int	lowSamp		= (int)whichSample;
+			const float rem			= whichSample - lowSamp;
+			// at 1 we are exactly on the last sample
+			return rem == 0.f ? table[lowSamp] : table[lowSamp] * ( 1.f - rem ) + table[lowSamp + 1] * rem;
+		}
+
+		// all levels, one after the other
+		float * mTables;
+		int		mSize;
+		float	mSizeForLookup;
+		int		mLevelCount;
+		// how many harmonics level 0 has
+		int		mHarmonicCount;
+	};
+}
+
+#endif // BANDLIMITEDWAVETABLE_H
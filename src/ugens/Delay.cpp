@@ -9,6 +9,7 @@
 
 #include "Delay.h"
 #include <algorithm>
+#include <string.h> // for memset
 
 Minim::Delay::Delay( const float maxDT, const float ampFactor, const bool feedback )
 : UGen()
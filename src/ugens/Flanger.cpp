@@ -8,11 +8,9 @@
 
 #include "Flanger.h"
 #include "Waves.h"
-#include <string> // for memset
+#include <string.h> // for memset
 #include <cassert>
 
-static Minim::Wavetable* SINE = Minim::Waves::SINE();
-
 Minim::Flanger::Flanger(float delayLength, float lfoRate, float delayDepth, float feedbackAmplitude, float dryAmplitude, float wetAmplitude)
 : UGen()
 , audio( *this, AUDIO )
@@ -25,6 +23,7 @@ Minim::Flanger::Flanger(float delayLength, float lfoRate, float delayDepth, floa
 , delayBuffer( NULL )
 , writeFrame( 0 )
 , bufferFrameLength( 0 )
+, lfoShape( Minim::Waves::shared( Minim::Waves::eSine ) )
 , step( 0 )
 , stepSize( 0 )
 , prevFreq( 0 )
@@ -38,6 +37,7 @@ Minim::Flanger::~Flanger()
     {
         delete [] delayBuffer;
     }
+    lfoShape->release();
 }
 
 void Minim::Flanger::reset()
@@ -73,7 +73,7 @@ void Minim::Flanger::uGenerate(float* out, const int numChannels)
     assert( numChannels == getAudioChannelCount() );
     
     // generate lfo value
-    const float lfo = SINE->value( step );
+    const float lfo = lfoShape->value( step );
     
     // modulate the delay amount using the lfo value.
     // we always modulate to a value larger than the input delay.
@@ -13,6 +13,8 @@
 
 namespace Minim 
 {
+    class Wavetable;
+    
     /**
      * A Flanger is a specialized kind of delay that uses an LFO (low frequency
      * oscillator) to vary the amount of delay applied to each sample. This causes a
@@ -123,6 +125,8 @@ namespace Minim
         // LFO
         // ////////////
         
+        // a sine shared with every other Flanger
+        const Wavetable* lfoShape;
         // where we will sample our waveform, moves between [0,1]
         float		step;
         // the step size we will use to advance our step
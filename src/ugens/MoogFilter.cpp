@@ -8,7 +8,7 @@
  */
 
 #include "MoogFilter.h"
-#include <string>
+#include <string.h> // for memset
 #include <math.h>
 
 #if WIN32
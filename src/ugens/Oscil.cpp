@@ -19,11 +19,13 @@
 #include "Oscil.h"
 #include "Frequency.h"
 #include "Waveform.h"
+#include "Wavetable.h"
 #include <math.h>
+#include <string.h> // for memcpy
 
 namespace Minim  
 {
-	Oscil::Oscil( const float freq, float amp, Waveform * wave )
+	Oscil::Oscil( const float freq, float amp, const Waveform * wave, const Interpolation interpolation )
 	: UGen()
 	, amplitude( *this, CONTROL ) 
 	, frequency( *this, CONTROL )
@@ -33,14 +35,17 @@ namespace Minim
 	, mPrevFreq(freq)
 	, mStep(0.f)
 	, oneOverSampleRate(0)
+	, mPhase(0)
+	, mIncrement(0)
 	{
 		amplitude.setLastValue( amp );
 		frequency.setLastValue( freq );
 		phase.setLastValue( 0.f );
 		offset.setLastValue( 0.f );
+		init( interpolation );
 	}
 	
-	Oscil::Oscil( const Frequency & freq, float amp, Waveform * wave )
+	Oscil::Oscil( const Frequency & freq, float amp, const Waveform * wave, const Interpolation interpolation )
 	: UGen()
 	, amplitude( *this, CONTROL ) 
 	, frequency( *this, CONTROL )
@@ -50,21 +55,95 @@ namespace Minim
 	, mPrevFreq(freq.asHz())
 	, mStep(0.f)
 	, oneOverSampleRate(0)
+	, mPhase(0)
+	, mIncrement(0)
 	{
 		amplitude.setLastValue( amp );
 		frequency.setLastValue( freq.asHz() );
 		phase.setLastValue( 0.f );
 		offset.setLastValue( 0.f );
+		init( interpolation );
+	}
+	
+	const double Oscil::kStepToPhase = 4294967296.0;
+	const float	 Oscil::kPhaseToStep = 1.f / 4294967296.f;
+	
+	namespace
+	{
+		// Interpolations for Oscil::generateTable.
+		// tables are one cycle with the first sample repeated at the end, period samples apart,
+		// and index is in [0, period).
+		struct NoInterpolation
+		{
+			static inline float value( const float * table, const unsigned int /*period*/, const unsigned int index, const float /*frac*/ )
+			{
+				return table[index];
+			}
+		};
+		
+		struct LinearInterpolation
+		{
+			static inline float value( const float * table, const unsigned int /*period*/, const unsigned int index, const float frac )
+			{
+				return table[index] + ( table[index+1] - table[index] ) * frac;
+			}
+		};
+		
+		// four point, third order Hermite
+		struct CubicInterpolation
+		{
+			static inline float value( const float * table, const unsigned int period, const unsigned int index, const float frac )
+			{
+				const float y0 = table[ index > 0 ? index - 1 : period - 1 ];
+				const float y1 = table[index];
+				const float y2 = table[index+1];
+				const float y3 = table[ index + 2 <= period ? index + 2 : index + 2 - period ];
+				
+				const float c1 = 0.5f * ( y2 - y0 );
+				const float c2 = y0 - 2.5f * y1 + 2.f * y2 - 0.5f * y3;
+				const float c3 = 0.5f * ( y3 - y0 ) + 1.5f * ( y1 - y2 );
+				return ( ( c3 * frac + c2 ) * frac + c1 ) * frac + y1;
+			}
+		};
+	}
+	
+	/////////////////////////////////////////////////////////
+	void Oscil::init( const Interpolation interpolation )
+	{
+		mTable = mWaveform && interpolation != eWaveform ? mWaveform->asWavetable() : NULL;
+		// a table needs two samples to be one cycle
+		if ( mTable && mTable->size() < 2 )
+		{
+			mTable = NULL;
+		}
+		mInterpolation = mTable ? interpolation : eWaveform;
+		
+		switch( mInterpolation )
+		{
+			case eNone:   mGenerate = &Oscil::generateTable<NoInterpolation>; break;
+			case eLinear: mGenerate = &Oscil::generateTable<LinearInterpolation>; break;
+			case eCubic:  mGenerate = &Oscil::generateTable<CubicInterpolation>; break;
+			default:	  mGenerate = &Oscil::generateWaveform; break;
+		}
 	}
 	
 	Oscil::~Oscil()
 	{
-		delete mWaveform;
-        mWaveform = NULL;
+		if ( mWaveform )
+		{
+			mWaveform->release();
+			mWaveform = NULL;
+		}
 	}
 	
 	/////////////////////////////////////////////////////////
 	void Oscil::uGenerate(float * channels, const int numChannels) 
+	{
+		(this->*mGenerate)( channels, numChannels );
+	}
+	
+	/////////////////////////////////////////////////////////
+	void Oscil::generateWaveform(float * channels, const int numChannels) 
 	{		
 		// CodeTimer timer("Oscil:uGenerate");
 		
@@ -84,7 +163,7 @@ namespace Minim
 		}
 		
 		// calculate the sample values
-		const float sample = outAmp * mWaveform->value( tmpStep ) + offset.getLastValue();
+		const float sample = outAmp * mWaveform->value( tmpStep, mStepSize ) + offset.getLastValue();
 		
         UGen::fill( channels, sample, numChannels );
 		
@@ -110,5 +189,150 @@ namespace Minim
 		}	
 	}
 	
+	/////////////////////////////////////////////////////////
+	template<typename Interpolate>
+	void Oscil::generateTable(float * channels, const int numChannels) 
+	{
+		const float * table = mTable->getWaveform();
+		// the table is closed, its last sample is its first, so a cycle is one sample shorter
+		const unsigned int period = (unsigned int)mTable->size() - 1;
+		
+		// the phase input is in cycles, any whole number of them disappears when we wrap
+		const unsigned int at = mPhase + (unsigned int)(long long)( (double)phase.getLastValue() * kStepToPhase );
+		
+		// the top bits of at times period are the sample, the bottom bits how far past it we are.
+		// when period is a power of two, this is just the top bits of at.
+		const unsigned long long scaled = (unsigned long long)at * period;
+		const unsigned int index = (unsigned int)( scaled >> 32 );
+		const float frac = (unsigned int)scaled * kPhaseToStep;
+		
+		const float sample = amplitude.getLastValue() * Interpolate::value( table, period, index, frac ) + offset.getLastValue();
+		
+		UGen::fill( channels, sample, numChannels );
+		
+		// update our step size if the frequency changed.
+		if ( frequency.getLastValue() != mPrevFreq )
+		{
+			updateStepSize();
+			mPrevFreq = frequency.getLastValue();
+		}
+		
+		// increase time, wrapping around at the end of the cycle
+		mPhase += mIncrement;
+	}
+	
+	/////////////////////////////////////////////////////////
+	void Oscil::uGenerateBlock( float ** channels, const int numChannels, const int numFrames )
+	{
+		if ( numFrames <= 0 )
+		{
+			return;
+		}
+		
+		switch( mInterpolation )
+		{
+			case eNone:   generateTableBlock<NoInterpolation>( channels[0], numFrames ); break;
+			case eLinear: generateTableBlock<LinearInterpolation>( channels[0], numFrames ); break;
+			case eCubic:  generateTableBlock<CubicInterpolation>( channels[0], numFrames ); break;
+			default:	  generateWaveformBlock( channels[0], numFrames ); break;
+		}
+		
+		for( int c = 1; c < numChannels; ++c )
+		{
+			memcpy( channels[c], channels[0], sizeof(float)*numFrames );
+		}
+		
+		// leave our inputs where they would be if we had been ticked
+		amplitude.loadBlockFrame( numFrames - 1 );
+		frequency.loadBlockFrame( numFrames - 1 );
+		phase.loadBlockFrame( numFrames - 1 );
+		offset.loadBlockFrame( numFrames - 1 );
+	}
+	
+	/////////////////////////////////////////////////////////
+	const float * Oscil::blockValues( const UGenInput & input, int & stride )
+	{
+		float * const * block = input.getBlockValues();
+		stride = block ? 1 : 0;
+		return block ? block[0] : input.getLastValues();
+	}
+	
+	/////////////////////////////////////////////////////////
+	void Oscil::generateWaveformBlock( float * out, const int numFrames )
+	{
+		int ampStride, freqStride, phaseStride, offsetStride;
+		const float * amp  = blockValues( amplitude, ampStride );
+		const float * freq = blockValues( frequency, freqStride );
+		const float * ph   = blockValues( phase, phaseStride );
+		const float * off  = blockValues( offset, offsetStride );
+		
+		for( int i = 0; i < numFrames; ++i )
+		{
+			// the same as generateWaveform, one frame at a time
+			float tmpStep = mStep + ph[i*phaseStride];
+			if ( tmpStep < 0.f )
+			{
+				tmpStep -= static_cast<int>(tmpStep) - 1.f;
+			}
+			else if ( tmpStep > 1.0f )
+			{
+				tmpStep -= static_cast<int>(tmpStep);
+			}
+			
+			out[i] = amp[i*ampStride] * mWaveform->value( tmpStep, mStepSize ) + off[i*offsetStride];
+			
+			const float f = freq[i*freqStride];
+			if ( f != mPrevFreq )
+			{
+				updateStepSize( f );
+				mPrevFreq = f;
+			}
+			
+			mStep += mStepSize;
+			if ( mStep < 0.f )
+			{
+				mStep -= static_cast<int>(mStep) - 1.f;
+			}
+			else if ( mStep > 1.0f )
+			{
+				mStep -= static_cast<int>(mStep);
+			}
+		}
+	}
+	
+	/////////////////////////////////////////////////////////
+	template<typename Interpolate>
+	void Oscil::generateTableBlock( float * out, const int numFrames )
+	{
+		const float * table = mTable->getWaveform();
+		const unsigned int period = (unsigned int)mTable->size() - 1;
+		
+		int ampStride, freqStride, phaseStride, offsetStride;
+		const float * amp  = blockValues( amplitude, ampStride );
+		const float * freq = blockValues( frequency, freqStride );
+		const float * ph   = blockValues( phase, phaseStride );
+		const float * off  = blockValues( offset, offsetStride );
+		
+		for( int i = 0; i < numFrames; ++i )
+		{
+			// the same as generateTable, one frame at a time
+			const unsigned int at = mPhase + (unsigned int)(long long)( (double)ph[i*phaseStride] * kStepToPhase );
+			
+			const unsigned long long scaled = (unsigned long long)at * period;
+			const unsigned int index = (unsigned int)( scaled >> 32 );
+			const float frac = (unsigned int)scaled * kPhaseToStep;
+			
+			out[i] = amp[i*ampStride] * Interpolate::value( table, period, index, frac ) + off[i*offsetStride];
+			
+			const float f = freq[i*freqStride];
+			if ( f != mPrevFreq )
+			{
+				updateStepSize( f );
+				mPrevFreq = f;
+			}
+			
+			mPhase += mIncrement;
+		}
+	}
+	
 }
-
@@ -22,19 +22,35 @@
 #include "UGen.h"
 #include "Frequency.h"
 
+#include <math.h>
+
 namespace Minim 
 {
 	
 	class Waveform;
+	class Wavetable;
 	
 	class Oscil : public UGen 
 	{
 	public:
+		// how to read between the samples of a Wavetable.
+		// eWaveform asks the waveform for every sample, the way Oscil always has, and is what
+		// any waveform that isn't a plain Wavetable gets. the others keep a 32 bit phase
+		// that wraps on its own and read the table directly, with no branches per sample.
+		enum Interpolation
+		{
+			eWaveform,
+			eNone,
+			eLinear,
+			eCubic
+		};
+		
 		// TODO: I kind of hate that I'm gonna write it such that you 
 		//       have to make a new waveform for each oscillator, but 
 		//       I can't wrap my head around how to do it better right now.
-		Oscil( const float freqInHz, float amplitude, Waveform * wave );
-		Oscil( const Frequency & freq, float amplitude, Waveform * wave );
+		// we take the reference to wave that is passed in and release it when we are destroyed.
+		Oscil( const float freqInHz, float amplitude, const Waveform * wave, const Interpolation interpolation = eWaveform );
+		Oscil( const Frequency & freq, float amplitude, const Waveform * wave, const Interpolation interpolation = eWaveform );
 		virtual ~Oscil();
 		
 		UGenInput amplitude;
@@ -53,9 +69,12 @@ namespace Minim
 		void reset()
 		{
 			mStep = 0;
+			mPhase = 0;
 		}
 		
-		inline float getStep() const { return mStep; }
+		inline float getStep() const { return mTable ? mPhase * kPhaseToStep : mStep; }
+		
+		inline Interpolation getInterpolation() const { return mInterpolation; }
 		
 	protected:
 		// UGen override
@@ -67,21 +86,59 @@ namespace Minim
 		
 		// UGen impl
 		virtual void uGenerate( float * channels, const int numChannels );
+		virtual void uGenerateBlock( float ** channels, const int numChannels, const int numFrames );
 		
 	private:
 		
+		void init( const Interpolation interpolation );
+		
 		inline void updateStepSize()
 		{
-			mStepSize = frequency.getLastValue() * oneOverSampleRate;
+			updateStepSize( frequency.getLastValue() );
 		}
 		
+		inline void updateStepSize( const float freq )
+		{
+			mStepSize = freq * oneOverSampleRate;
+			// in double, because a float step size drifts audibly out of phase over a few seconds.
+			// negative frequencies wrap around to step backwards.
+			const double rate = sampleRate();
+			mIncrement = rate > 0 ? (unsigned int)(long long)floor( freq / rate * kStepToPhase + 0.5 ) : 0;
+		}
+		
+		// uGenerate for each kind of Interpolation
+		typedef void (Oscil::*Generator)( float * channels, const int numChannels );
+		void generateWaveform( float * channels, const int numChannels );
+		template<typename Interpolate>
+		void generateTable( float * channels, const int numChannels );
+		
+		// uGenerateBlock for each kind of Interpolation, into one channel
+		void generateWaveformBlock( float * out, const int numFrames );
+		template<typename Interpolate>
+		void generateTableBlock( float * out, const int numFrames );
+		
+		// the block of input if something generated one, otherwise its last value with a stride of 0,
+		// so that values[frame*stride] is the value of input at every frame either way.
+		static const float * blockValues( const UGenInput & input, int & stride );
+		
+		static const double kStepToPhase;
+		static const float	kPhaseToStep;
+		
 		float mPrevFreq;
 		
-		Waveform * mWaveform;
+		const Waveform * mWaveform;
+		// mWaveform, if we read it directly
+		const Wavetable * mTable;
+		Interpolation	mInterpolation;
+		Generator		mGenerate;
 		
 		float mStep;
 		float mStepSize;
 		float oneOverSampleRate;
+		
+		// a whole cycle is 2^32
+		unsigned int mPhase;
+		unsigned int mIncrement;
 	};
 	
 }
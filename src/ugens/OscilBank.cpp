@@ -0,0 +1,224 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "OscilBank.h"
+#include "Waveform.h"
+#include "MixKernels.h"
+
+#define  _USE_MATH_DEFINES // required in windows to get constants like M_PI
+#include <math.h>
+#include <string.h> // for memset, memcpy
+
+namespace Minim
+{
+	OscilBank::OscilBank( const int numPartials, const Waveform * wave )
+	: UGen()
+	, amplitude( *this, CONTROL )
+	, mPartialCount( numPartials > 0 ? numPartials : 0 )
+	, mFrequencies( mPartialCount, 0.f )
+	, mAmplitudes( mPartialCount, 0.f )
+	, mPhases( mPartialCount, 0 )
+	, mIncrements( mPartialCount, 0 )
+	, mAudible( mPartialCount, 0 )
+	, mPendingFrequencies( mPartialCount, 0.f )
+	, mPendingAmplitudes( mPartialCount, 0.f )
+	, mPendingChanged( false )
+	, mPendingReset( false )
+	{
+		amplitude.setLastValue( 1.f );
+
+		for( int i = 0; i < kTableSize; ++i )
+		{
+			const float at = (float)i / kTableSize;
+			mTable[i] = wave ? wave->value( at ) : (float)sin( 2 * M_PI * at );
+		}
+		mTable[kTableSize] = mTable[0];
+
+		if ( wave )
+		{
+			wave->release();
+		}
+	}
+
+	OscilBank::~OscilBank()
+	{
+	}
+
+	///////////////////////////////////////////////////
+	void OscilBank::setFrequencies( const float * frequencies, const int count, const int first )
+	{
+		std::lock_guard<std::mutex> lock( mPendingMutex );
+		for( int i = 0; i < count && first + i < mPartialCount; ++i )
+		{
+			mPendingFrequencies[first + i] = frequencies[i];
+		}
+		mPendingChanged = true;
+	}
+
+	///////////////////////////////////////////////////
+	void OscilBank::setAmplitudes( const float * amplitudes, const int count, const int first )
+	{
+		std::lock_guard<std::mutex> lock( mPendingMutex );
+		for( int i = 0; i < count && first + i < mPartialCount; ++i )
+		{
+			mPendingAmplitudes[first + i] = amplitudes[i];
+		}
+		mPendingChanged = true;
+	}
+
+	///////////////////////////////////////////////////
+	void OscilBank::setFrequency( const int partial, const float frequency )
+	{
+		setFrequencies( &frequency, 1, partial );
+	}
+
+	///////////////////////////////////////////////////
+	void OscilBank::setAmplitude( const int partial, const float partialAmplitude )
+	{
+		setAmplitudes( &partialAmplitude, 1, partial );
+	}
+
+	///////////////////////////////////////////////////
+	void OscilBank::setHarmonics( const float fundamental )
+	{
+		std::lock_guard<std::mutex> lock( mPendingMutex );
+		for( int i = 0; i < mPartialCount; ++i )
+		{
+			mPendingFrequencies[i] = fundamental * ( i + 1 );
+		}
+		mPendingChanged = true;
+	}
+
+	///////////////////////////////////////////////////
+	void OscilBank::reset()
+	{
+		mPendingReset = true;
+	}
+
+	///////////////////////////////////////////////////
+	void OscilBank::sampleRateChanged()
+	{
+		updateIncrements();
+	}
+
+	///////////////////////////////////////////////////
+	void OscilBank::updateIncrements()
+	{
+		const float rate = sampleRate();
+		for( int i = 0; i < mPartialCount; ++i )
+		{
+			const float frequency = mFrequencies[i];
+			mAudible[i] = rate > 0 && fabsf( frequency ) < rate * 0.5f;
+			// a whole cycle is 2^32, negative frequencies wrap around to step backwards.
+			// partials above Nyquist aren't heard, but keep their phase moving for when they come back down.
+			if ( mAudible[i] )
+			{
+				mIncrements[i] = (unsigned int)(long long)( frequency / rate * 4294967296.0 );
+			}
+			else if ( rate > 0 )
+			{
+				const double cycles = (double)frequency / rate;
+				mIncrements[i] = (unsigned int)( ( cycles - floor( cycles ) ) * 4294967296.0 );
+			}
+			else
+			{
+				mIncrements[i] = 0;
+			}
+		}
+	}
+
+	///////////////////////////////////////////////////
+	void OscilBank::receive()
+	{
+		if ( mPendingReset.exchange( false ) )
+		{
+			memset( &mPhases[0], 0, sizeof(unsigned int) * mPartialCount );
+		}
+
+		if ( mPendingChanged && mPendingMutex.try_lock() )
+		{
+			mFrequencies = mPendingFrequencies;
+			mAmplitudes	 = mPendingAmplitudes;
+			mPendingChanged = false;
+			mPendingMutex.unlock();
+
+			updateIncrements();
+		}
+	}
+
+	///////////////////////////////////////////////////
+	void OscilBank::uGenerate( float * channels, const int numChannels )
+	{
+		receive();
+
+		float sample = 0;
+		for( int i = 0; i < mPartialCount; ++i )
+		{
+			if ( mAudible[i] && mAmplitudes[i] != 0.f )
+			{
+				MixKernels::accumWavetable( &sample, mTable, kTableBits, mPhases[i], mIncrements[i], mAmplitudes[i], 1 );
+			}
+			else
+			{
+				mPhases[i] += mIncrements[i];
+			}
+		}
+
+		UGen::fill( channels, sample * amplitude.getLastValue(), numChannels );
+	}
+
+	///////////////////////////////////////////////////
+	void OscilBank::uGenerateBlock( float ** channels, const int numChannels, const int numFrames )
+	{
+		receive();
+
+		float * out = channels[0];
+		memset( out, 0, sizeof(float) * numFrames );
+
+		// a patched amplitude is applied to the sum, otherwise it's folded into every partial
+		float * const * amplitudeBlock = amplitude.getBlockValues();
+		const float gain = amplitudeBlock ? 1.f : amplitude.getLastValue();
+
+		for( int i = 0; i < mPartialCount; ++i )
+		{
+			if ( mAudible[i] && mAmplitudes[i] != 0.f )
+			{
+				MixKernels::accumWavetable( out, mTable, kTableBits, mPhases[i], mIncrements[i], mAmplitudes[i] * gain, numFrames );
+			}
+			else
+			{
+				// keep silent partials in phase with the rest
+				mPhases[i] += mIncrements[i] * (unsigned int)numFrames;
+			}
+		}
+
+		if ( amplitudeBlock )
+		{
+			const float * amp = amplitudeBlock[0];
+			for( int f = 0; f < numFrames; ++f )
+			{
+				out[f] *= amp[f];
+			}
+		}
+
+		for( int c = 1; c < numChannels; ++c )
+		{
+			memcpy( channels[c], out, sizeof(float) * numFrames );
+		}
+	}
+}
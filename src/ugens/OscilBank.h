@@ -0,0 +1,109 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef OSCILBANK_H
+#define OSCILBANK_H
+
+#include "UGen.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace Minim
+{
+	class Waveform;
+
+	/**
+	 * Many oscillators, called partials, playing the same waveform and summed together,
+	 * for additive synthesis. It does the work of as many Oscils patched to a Summer,
+	 * but keeps the phase, frequency, and amplitude of every partial in plain arrays
+	 * and renders each partial for a whole block at a time with MixKernels::accumWavetable,
+	 * so there are no inputs to walk or UGens to tick per partial.
+	 *
+	 * Frequencies and amplitudes are set in bulk from any thread. They are copied to the
+	 * audio thread at the start of the next block it generates, all at once, so a whole
+	 * spectrum changes on the same sample. Partials at or above Nyquist are silent,
+	 * but their phase keeps advancing, so one that drops back below it is where it would have been.
+	 *
+	 * The output is the same on every channel.
+	 */
+	class OscilBank : public UGen
+	{
+	public:
+		// wave is sampled into a table of our own and released, like an Oscil would when destroyed.
+		// with no wave the partials are sines.
+		OscilBank( const int numPartials, const Waveform * wave = NULL );
+		virtual ~OscilBank();
+
+		// scales the sum of the partials
+		UGenInput amplitude;
+
+		inline int getPartialCount() const { return mPartialCount; }
+
+		// set count partials starting with first, in Hz and linear amplitude.
+		void setFrequencies( const float * frequencies, const int count, const int first = 0 );
+		void setAmplitudes( const float * amplitudes, const int count, const int first = 0 );
+		void setFrequency( const int partial, const float frequency );
+		void setAmplitude( const int partial, const float partialAmplitude );
+
+		// tune partial n to n+1 times fundamental
+		void setHarmonics( const float fundamental );
+
+		// start every partial at the beginning of its cycle with the next block
+		void reset();
+
+	protected:
+		// UGen impl
+		virtual void sampleRateChanged();
+		virtual void uGenerate( float * channels, const int numChannels );
+		virtual void uGenerateBlock( float ** channels, const int numChannels, const int numFrames );
+
+	private:
+		// take what was set since the last block, if we can without waiting
+		void receive();
+		void updateIncrements();
+
+		enum
+		{
+			kTableBits = 12,
+			kTableSize = 1 << kTableBits
+		};
+
+		// one cycle of our waveform with the first sample repeated at the end
+		float					  mTable[kTableSize + 1];
+		int						  mPartialCount;
+
+		// what the audio thread renders with
+		std::vector<float>		  mFrequencies;
+		std::vector<float>		  mAmplitudes;
+		std::vector<unsigned int> mPhases;
+		std::vector<unsigned int> mIncrements;
+		// whether each partial is below Nyquist
+		std::vector<char>		  mAudible;
+
+		// what has been set, waiting for the audio thread
+		std::vector<float>		  mPendingFrequencies;
+		std::vector<float>		  mPendingAmplitudes;
+		std::mutex				  mPendingMutex;
+		std::atomic<bool>		  mPendingChanged;
+		std::atomic<bool>		  mPendingReset;
+	};
+}
+
+#endif // OSCILBANK_H
@@ -8,6 +8,7 @@
  */
 
 #include "Pan.h"
+#include "UGenSchedule.h"
 
 #define  _USE_MATH_DEFINES // required in windows to get constants like M_PI
 #include <math.h>
@@ -32,6 +33,7 @@ namespace Minim
 	{
 		m_audio = in;
 		m_audio->setAudioChannelCount(1);
+		UGenSchedule::invalidate();
 	}
 	
 	void Pan::removeInput( UGen * in )
@@ -39,6 +41,17 @@ namespace Minim
 		if ( m_audio == in )
 		{
 			m_audio = NULL;
+			UGenSchedule::invalidate();
+		}
+	}
+	
+	void Pan::getInputUGens( std::vector<UGen*> & inputs )
+	{
+		UGen::getInputUGens( inputs );
+		
+		if ( m_audio != NULL )
+		{
+			inputs.push_back( m_audio );
 		}
 	}
 	
@@ -71,8 +84,45 @@ namespace Minim
 			return;
 		}
 		
-		const float panValue = pan.getLastValue();
+		float leftAmp, rightAmp;
+		panGains( pan.getLastValue(), leftAmp, rightAmp );
 		
+		sampleFrame[0] = sample * leftAmp;
+		sampleFrame[1] = sample * rightAmp;
+	}
+	
+	void Pan::uGenerateBlock( float ** channels, const int numChannels, const int numFrames )
+	{
+		// our audio generated its block as MONO before we were asked for ours, 
+		// it won't have if it was patched to us after we were scheduled.
+		float * const * audioBlock = m_audio != NULL ? getInputBlock( *m_audio ) : NULL;
+		const float * audio = audioBlock ? audioBlock[0] : NULL;
+		
+		for( int i = 0; i < numFrames; ++i )
+		{
+			const float sample = audio ? audio[i] : 0.f;
+			
+			if ( numChannels != 2 )
+			{
+				for( int c = 0; c < numChannels; ++c )
+				{
+					channels[c][i] = sample;
+				}
+				continue;
+			}
+			
+			pan.loadBlockFrame( i );
+			
+			float leftAmp, rightAmp;
+			panGains( pan.getLastValue(), leftAmp, rightAmp );
+			
+			channels[0][i] = sample * leftAmp;
+			channels[1][i] = sample * rightAmp;
+		}
+	}
+	
+	void Pan::panGains( const float panValue, float & leftAmp, float & rightAmp )
+	{
 		// formula swiped from the MIDI spcification: http://www.midi.org/about-midi/rp36.shtml
 		// Left Channel Gain [dB] = 20*log (cos (Pi/2* max(0,CC#10 ñ 1)/126)
 		// Right Channel Gain [dB] = 20*log (sin (Pi /2* max(0,CC#10 ñ 1)/126)
@@ -88,10 +138,7 @@ namespace Minim
 		
 		// note that I am calculating amplitude directly, by using the linear value
 		// that the MIDI specification suggests inputing into the dB formula.
-		const float leftAmp = cosf( M_PI_2 * normBalance );
-		const float rightAmp = sinf( M_PI_2 * normBalance);
-		
-		sampleFrame[0] = sample * leftAmp;
-		sampleFrame[1] = sample * rightAmp;
+		leftAmp = cosf( M_PI_2 * normBalance );
+		rightAmp = sinf( M_PI_2 * normBalance);
 	}
 }
\ No newline at end of file
@@ -31,9 +31,14 @@ namespace Minim
 		virtual void removeInput( UGen * input );
 		virtual void sampleRateChanged();
 		virtual void uGenerate( float * sampleFrame, const int numChannels );
+		virtual void uGenerateBlock( float ** channels, const int numChannels, const int numFrames );
+		virtual void getInputUGens( std::vector<UGen*> & inputs );
 		
 	private:
 		
+		// the gain of each stereo channel for panValue
+		static void panGains( const float panValue, float & leftAmp, float & rightAmp );
+		
 		UGen * m_audio;
 		
 	};
@@ -8,7 +8,7 @@
  */
 
 #include "Sampler.h"
-#include <string>
+#include <string.h> // for memset
 #include <cassert>
 #include <algorithm>
 
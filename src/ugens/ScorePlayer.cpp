@@ -0,0 +1,627 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "ScorePlayer.h"
+#include "AudioOutput.h"
+#include "VoicePool.h"
+#include "Logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace Minim
+{
+	// the binary format is this, a version, and the number of notes,
+	// followed by the notes, each a double and three floats, all little endian.
+	static const char		  kBinaryMagic[4]	= { 'M', 'N', 'S', 'C' };
+	static const unsigned int kBinaryVersion	= 1;
+	static const int		  kBinaryHeaderSize = 12;
+	static const int		  kBinaryNoteSize	= 20;
+	// how many notes we read or write at a time
+	static const int		  kBinaryChunk		= 4096;
+
+	static void putU32( unsigned char * out, const unsigned int value )
+	{
+		for( int i = 0; i < 4; ++i )
+		{
+			out[i] = (unsigned char)( value >> ( 8 * i ) );
+		}
+	}
+
+	static unsigned int getU32( const unsigned char * in )
+	{
+		return in[0] | ( in[1] << 8 ) | ( in[2] << 16 ) | ( (unsigned int)in[3] << 24 );
+	}
+
+	static void putU64( unsigned char * out, const unsigned long long value )
+	{
+		for( int i = 0; i < 8; ++i )
+		{
+			out[i] = (unsigned char)( value >> ( 8 * i ) );
+		}
+	}
+
+	static unsigned long long getU64( const unsigned char * in )
+	{
+		unsigned long long value = 0;
+		for( int i = 7; i >= 0; --i )
+		{
+			value = ( value << 8 ) | in[i];
+		}
+		return value;
+	}
+
+	static void putFloat( unsigned char * out, const float value )
+	{
+		unsigned int bits;
+		memcpy( &bits, &value, 4 );
+		putU32( out, bits );
+	}
+
+	static float getFloat( const unsigned char * in )
+	{
+		const unsigned int bits = getU32( in );
+		float value;
+		memcpy( &value, &bits, 4 );
+		return value;
+	}
+
+	static bool noteStartsBefore( const Score::Note & a, const Score::Note & b )
+	{
+		return a.start < b.start;
+	}
+
+	Score::Score()
+	: mSorted( true )
+	{
+	}
+
+	///////////////////////////////////////////////////
+	void Score::addNote( const double start, const float duration, const float frequency, const float amplitude )
+	{
+		Note note;
+		note.start	   = start;
+		note.duration  = duration;
+		note.frequency = frequency;
+		note.amplitude = amplitude;
+
+		if ( !mNotes.empty() && start < mNotes.back().start )
+		{
+			mSorted = false;
+		}
+		mNotes.push_back( note );
+	}
+
+	///////////////////////////////////////////////////
+	void Score::sort()
+	{
+		if ( !mSorted )
+		{
+			// stable, so notes that start together are played in the order they were added
+			std::stable_sort( mNotes.begin(), mNotes.end(), noteStartsBefore );
+			mSorted = true;
+		}
+	}
+
+	///////////////////////////////////////////////////
+	void Score::clear()
+	{
+		mNotes.clear();
+		mSorted = true;
+	}
+
+	///////////////////////////////////////////////////
+	double Score::getLength() const
+	{
+		double length = 0;
+		for( size_t i = 0; i < mNotes.size(); ++i )
+		{
+			length = std::max( length, mNotes[i].start + mNotes[i].duration );
+		}
+		return length;
+	}
+
+	///////////////////////////////////////////////////
+	bool Score::saveBinary( const char * filename ) const
+	{
+		FILE * file = fopen( filename, "wb" );
+		if ( !file )
+		{
+			Minim::error( "Score::saveBinary: couldn't open the file for writing." );
+			return false;
+		}
+
+		unsigned char header[kBinaryHeaderSize];
+		memcpy( header, kBinaryMagic, 4 );
+		putU32( header + 4, kBinaryVersion );
+		putU32( header + 8, (unsigned int)mNotes.size() );
+		bool ok = fwrite( header, kBinaryHeaderSize, 1, file ) == 1;
+
+		std::vector<unsigned char> chunk( kBinaryChunk * kBinaryNoteSize );
+		for( size_t first = 0; ok && first < mNotes.size(); first += kBinaryChunk )
+		{
+			const size_t count = std::min( mNotes.size() - first, (size_t)kBinaryChunk );
+			for( size_t i = 0; i < count; ++i )
+			{
+				const Note & note = mNotes[first + i];
+				unsigned char * out = &chunk[i * kBinaryNoteSize];
+				unsigned long long start;
+				memcpy( &start, &note.start, 8 );
+				putU64( out, start );
+				putFloat( out + 8, note.duration );
+				putFloat( out + 12, note.frequency );
+				putFloat( out + 16, note.amplitude );
+			}
+			ok = fwrite( &chunk[0], kBinaryNoteSize, count, file ) == count;
+		}
+
+		if ( fclose( file ) != 0 || !ok )
+		{
+			Minim::error( "Score::saveBinary: couldn't write the file." );
+			return false;
+		}
+		return true;
+	}
+
+	///////////////////////////////////////////////////
+	bool Score::loadBinary( const char * filename )
+	{
+		clear();
+
+		FILE * file = fopen( filename, "rb" );
+		if ( !file )
+		{
+			Minim::error( "Score::loadBinary: couldn't open the file." );
+			return false;
+		}
+
+		unsigned char header[kBinaryHeaderSize];
+		if ( fread( header, kBinaryHeaderSize, 1, file ) != 1
+			|| memcmp( header, kBinaryMagic, 4 ) != 0
+			|| getU32( header + 4 ) != kBinaryVersion )
+		{
+			Minim::error( "Score::loadBinary: not a score file." );
+			fclose( file );
+			return false;
+		}
+
+		const size_t total = getU32( header + 8 );
+		mNotes.reserve( total );
+
+		std::vector<unsigned char> chunk( kBinaryChunk * kBinaryNoteSize );
+		while ( mNotes.size() < total )
+		{
+			const size_t count = std::min( total - mNotes.size(), (size_t)kBinaryChunk );
+			if ( fread( &chunk[0], kBinaryNoteSize, count, file ) != count )
+			{
+				Minim::error( "Score::loadBinary: the file is truncated." );
+				fclose( file );
+				clear();
+				return false;
+			}
+
+			for( size_t i = 0; i < count; ++i )
+			{
+				const unsigned char * in = &chunk[i * kBinaryNoteSize];
+				const unsigned long long bits = getU64( in );
+				double start;
+				memcpy( &start, &bits, 8 );
+				addNote( start, getFloat( in + 8 ), getFloat( in + 12 ), getFloat( in + 16 ) );
+			}
+		}
+
+		fclose( file );
+
+		// it should have been saved sorted, in which case this does nothing
+		sort();
+		return true;
+	}
+
+	///////////////////////////////////////////////////
+	bool Score::loadMidi( const char * filename )
+	{
+		FILE * file = fopen( filename, "rb" );
+		if ( !file )
+		{
+			clear();
+			Minim::error( "Score::loadMidi: couldn't open the file." );
+			return false;
+		}
+
+		std::vector<unsigned char> data;
+		unsigned char chunk[4096];
+		size_t read;
+		while ( ( read = fread( chunk, 1, sizeof(chunk), file ) ) > 0 )
+		{
+			data.insert( data.end(), chunk, chunk + read );
+		}
+		fclose( file );
+
+		if ( data.empty() )
+		{
+			clear();
+			Minim::error( "Score::loadMidi: the file is empty." );
+			return false;
+		}
+
+		return loadMidi( &data[0], data.size() );
+	}
+
+	// a note from a midi file, in ticks
+	struct MidiNote
+	{
+		unsigned long	startTick;
+		unsigned long	endTick;
+		int				key;
+		int				velocity;
+	};
+
+	// where the tempo changes, and how many seconds into the file that is
+	struct MidiTempo
+	{
+		unsigned long	tick;
+		double			seconds;
+		double			secondsPerTick;
+	};
+
+	static bool tempoStartsBefore( const MidiTempo & a, const MidiTempo & b )
+	{
+		return a.tick < b.tick;
+	}
+
+	static bool tickIsBefore( const unsigned long tick, const MidiTempo & tempo )
+	{
+		return tick < tempo.tick;
+	}
+
+	static unsigned int readBigEndian( const unsigned char * data, const int bytes )
+	{
+		unsigned int value = 0;
+		for( int i = 0; i < bytes; ++i )
+		{
+			value = ( value << 8 ) | data[i];
+		}
+		return value;
+	}
+
+	// reads a midi variable length number at pos, and moves pos past it
+	static unsigned long readVariableLength( const unsigned char * data, size_t & pos, const size_t end )
+	{
+		unsigned long value = 0;
+		for( int i = 0; i < 4 && pos < end; ++i )
+		{
+			const unsigned char byte = data[pos++];
+			value = ( value << 7 ) | ( byte & 0x7F );
+			if ( ( byte & 0x80 ) == 0 )
+			{
+				break;
+			}
+		}
+		return value;
+	}
+
+	///////////////////////////////////////////////////
+	bool Score::loadMidi( const unsigned char * data, const size_t length )
+	{
+		clear();
+
+		if ( length < 14 || memcmp( data, "MThd", 4 ) != 0 )
+		{
+			Minim::error( "Score::loadMidi: not a MIDI file." );
+			return false;
+		}
+
+		const unsigned int headerLength = readBigEndian( data + 4, 4 );
+		const unsigned int trackCount	= readBigEndian( data + 10, 2 );
+		const unsigned int division		= readBigEndian( data + 12, 2 );
+
+		std::vector<MidiNote>  notes;
+		std::vector<MidiTempo> tempos;
+		// the notes that are on for each channel and key, oldest first
+		std::vector< std::vector<size_t> > held( 16 * 128 );
+
+		size_t chunkStart = 8 + (size_t)headerLength;
+		unsigned int track = 0;
+		while ( track < trackCount && chunkStart + 8 <= length )
+		{
+			const size_t chunkLength = readBigEndian( data + chunkStart + 4, 4 );
+			const size_t chunkEnd	 = chunkStart + 8 + chunkLength;
+			const bool	 isTrack	 = memcmp( data + chunkStart, "MTrk", 4 ) == 0;
+			// a truncated file still gets whatever is there
+			const size_t end		 = std::min( chunkEnd, length );
+			size_t		 pos		 = chunkStart + 8;
+			chunkStart = chunkEnd;
+
+			// skip chunks we don't know about
+			if ( !isTrack )
+			{
+				continue;
+			}
+			++track;
+
+			unsigned long tick	 = 0;
+			unsigned char status = 0;
+			while ( pos < end )
+			{
+				tick += readVariableLength( data, pos, end );
+				if ( pos >= end )
+				{
+					break;
+				}
+
+				if ( data[pos] & 0x80 )
+				{
+					status = data[pos++];
+				}
+				else if ( status == 0 )
+				{
+					// running status with nothing to run with
+					break;
+				}
+
+				if ( status == 0xFF )
+				{
+					if ( pos >= end )
+					{
+						break;
+					}
+					const unsigned char type = data[pos++];
+					const unsigned long size = readVariableLength( data, pos, end );
+					if ( type == 0x51 && size == 3 && pos + 3 <= end )
+					{
+						MidiTempo tempo;
+						tempo.tick			 = tick;
+						tempo.seconds		 = 0;
+						tempo.secondsPerTick = readBigEndian( data + pos, 3 ) / 1000000.0;
+						tempos.push_back( tempo );
+					}
+					pos += size;
+					// meta events and sysex cancel running status
+					status = 0;
+				}
+				else if ( status == 0xF0 || status == 0xF7 )
+				{
+					pos += readVariableLength( data, pos, end );
+					status = 0;
+				}
+				else
+				{
+					const int kind	  = status & 0xF0;
+					const int channel = status & 0x0F;
+					const size_t size = ( kind == 0xC0 || kind == 0xD0 ) ? 1 : 2;
+					if ( pos + size > end )
+					{
+						break;
+					}
+					const int key	   = data[pos] & 0x7F;
+					const int velocity = size > 1 ? data[pos + 1] & 0x7F : 0;
+					pos += size;
+
+					std::vector<size_t> & on = held[channel * 128 + key];
+					if ( kind == 0x90 && velocity > 0 )
+					{
+						MidiNote note;
+						note.startTick = tick;
+						note.endTick   = tick;
+						note.key	   = key;
+						note.velocity  = velocity;
+						on.push_back( notes.size() );
+						notes.push_back( note );
+					}
+					else if ( ( kind == 0x80 || kind == 0x90 ) && !on.empty() )
+					{
+						notes[ on.front() ].endTick = tick;
+						on.erase( on.begin() );
+					}
+				}
+			}
+
+			// anything still on ends with the track
+			for( size_t i = 0; i < held.size(); ++i )
+			{
+				for( size_t n = 0; n < held[i].size(); ++n )
+				{
+					notes[ held[i][n] ].endTick = tick;
+				}
+				held[i].clear();
+			}
+		}
+
+		if ( track == 0 )
+		{
+			Minim::error( "Score::loadMidi: the file has no tracks." );
+			return false;
+		}
+
+		// turn the tempo changes into a map from ticks to seconds
+		if ( division & 0x8000 )
+		{
+			// SMPTE time is frames per second and ticks per frame, and doesn't change
+			const int framesPerSecond = -(signed char)( division >> 8 );
+			const int ticksPerFrame	  = division & 0xFF;
+			const double fps		  = framesPerSecond == 29 ? 29.97 : framesPerSecond;
+
+			MidiTempo tempo;
+			tempo.tick			 = 0;
+			tempo.seconds		 = 0;
+			tempo.secondsPerTick = 1.0 / ( fps * std::max( ticksPerFrame, 1 ) );
+			tempos.assign( 1, tempo );
+		}
+		else
+		{
+			const double ticksPerQuarter = std::max( division, 1u );
+			for( size_t i = 0; i < tempos.size(); ++i )
+			{
+				tempos[i].secondsPerTick /= ticksPerQuarter;
+			}
+
+			// 120 BPM until we're told otherwise
+			MidiTempo tempo;
+			tempo.tick			 = 0;
+			tempo.seconds		 = 0;
+			tempo.secondsPerTick = 0.5 / ticksPerQuarter;
+			tempos.insert( tempos.begin(), tempo );
+			std::stable_sort( tempos.begin(), tempos.end(), tempoStartsBefore );
+
+			for( size_t i = 1; i < tempos.size(); ++i )
+			{
+				tempos[i].seconds = tempos[i-1].seconds + ( tempos[i].tick - tempos[i-1].tick ) * tempos[i-1].secondsPerTick;
+			}
+		}
+
+		mNotes.reserve( notes.size() );
+		for( size_t i = 0; i < notes.size(); ++i )
+		{
+			const MidiNote & note = notes[i];
+
+			double seconds[2];
+			const unsigned long ticks[2] = { note.startTick, note.endTick };
+			for( int t = 0; t < 2; ++t )
+			{
+				// the last tempo change at or before this tick, there's always one at 0
+				const MidiTempo & tempo = *( std::upper_bound( tempos.begin(), tempos.end(), ticks[t], tickIsBefore ) - 1 );
+				seconds[t] = tempo.seconds + ( ticks[t] - tempo.tick ) * tempo.secondsPerTick;
+			}
+
+			addNote( seconds[0],
+					 (float)( seconds[1] - seconds[0] ),
+					 440.f * powf( 2.f, ( note.key - 69 ) / 12.f ),
+					 note.velocity / 127.f );
+		}
+
+		// tracks are each in order, but not with each other
+		sort();
+		return true;
+	}
+
+	ScorePlayer::ScorePlayer( AudioOutput & output, VoicePool & voices, const float lookahead )
+	: mOutput( output )
+	, mVoices( voices )
+	, mLookahead( lookahead )
+	, mScore( NULL )
+	, mNext( 0 )
+	, mBeat( 0 )
+	, mPlaying( false )
+	, mStopping( false )
+	, mDropped( 0 )
+	{
+		mFeeder.mPlayer = this;
+	}
+
+	ScorePlayer::~ScorePlayer()
+	{
+	}
+
+	///////////////////////////////////////////////////
+	bool ScorePlayer::play( const Score & score, const float startTime )
+	{
+		if ( mPlaying )
+		{
+			return false;
+		}
+
+		if ( !score.isSorted() )
+		{
+			Minim::error( "ScorePlayer::play: the score needs to be sorted first." );
+			return false;
+		}
+
+		mScore	  = &score;
+		mNext	  = 0;
+		mBeat	  = 0;
+		mStopping = false;
+		mDropped  = 0;
+
+		if ( score.size() == 0 )
+		{
+			return true;
+		}
+
+		mPlaying = true;
+		// start the feeder with the first note, but never before startTime
+		const double first = std::max( score.getNote( 0 ).start, 0.0 );
+		mBeat = first;
+		mOutput.playNote( startTime + (float)first, 0, mFeeder );
+		return true;
+	}
+
+	///////////////////////////////////////////////////
+	void ScorePlayer::stop()
+	{
+		if ( mPlaying )
+		{
+			mStopping = true;
+		}
+	}
+
+	///////////////////////////////////////////////////
+	void ScorePlayer::Feeder::noteOn( float /*duration*/ )
+	{
+		mPlayer->feed();
+	}
+
+	///////////////////////////////////////////////////
+	void ScorePlayer::feed()
+	{
+		if ( mStopping )
+		{
+			mPlaying = false;
+			return;
+		}
+
+		const Score & score = *mScore;
+		const size_t count	= score.size();
+		const double until	= mBeat + mLookahead;
+		const double framesPerBeat = mOutput.sampleRate() * 60.0 / mOutput.getTempo();
+
+		while ( mNext < count )
+		{
+			const Score::Note & note = score.getNote( mNext );
+			if ( note.start >= until )
+			{
+				break;
+			}
+
+			const float startTime = note.start > mBeat ? (float)( note.start - mBeat ) : 0.f;
+			if ( !mVoices.playNote( startTime, note.duration, note.frequency, note.amplitude ) )
+			{
+				// try again when it should start, unless that's now
+				if ( startTime * framesPerBeat >= 1 )
+				{
+					break;
+				}
+				++mDropped;
+			}
+			++mNext;
+		}
+
+		if ( mNext == count )
+		{
+			mPlaying = false;
+			return;
+		}
+
+		// run again when the next note should start. we move by a whole number of sample frames,
+		// just like the NoteManager will, so that rounding doesn't add up over a long score.
+		const double frames = std::max( 1.0, std::floor( ( score.getNote( mNext ).start - mBeat ) * framesPerBeat ) );
+		mBeat += frames / framesPerBeat;
+		mOutput.playNote( (float)( ( frames + 0.25 ) / framesPerBeat ), 0, mFeeder );
+	}
+}
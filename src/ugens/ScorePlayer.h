@@ -0,0 +1,155 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef SCOREPLAYER_H
+#define SCOREPLAYER_H
+
+#include "Instrument.h"
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace Minim
+{
+	class AudioOutput;
+	class VoicePool;
+
+	/**
+	 * A list of notes, kept in one flat array sorted by start time so that a ScorePlayer
+	 * can walk through it without doing any work up front. Times are in beats,
+	 * like they are for AudioOutput::playNote.
+	 *
+	 * A Score can be loaded from a Standard MIDI File, in which case the tempo map
+	 * is applied while loading and times are in seconds, which is to say beats at 60 BPM,
+	 * the output's default tempo. Key becomes frequency and velocity becomes amplitude.
+	 *
+	 * It can also be saved to and loaded from a compact binary format, which is just
+	 * a short header followed by the notes, already sorted, so it loads as fast as it can be read.
+	 */
+	class Score
+	{
+	public:
+		struct Note
+		{
+			double	start;
+			float	duration;
+			float	frequency;
+			float	amplitude;
+		};
+
+		Score();
+
+		// these replace whatever we had and return false if the data can't be read.
+		bool loadMidi( const char * filename );
+		bool loadMidi( const unsigned char * data, const size_t length );
+		bool loadBinary( const char * filename );
+		bool saveBinary( const char * filename ) const;
+
+		void addNote( const double start, const float duration, const float frequency, const float amplitude );
+		// call this after adding notes and before playing. loading does it for you.
+		void sort();
+		inline bool isSorted() const { return mSorted; }
+
+		void clear();
+		inline void reserve( const size_t count ) { mNotes.reserve( count ); }
+
+		inline size_t		size() const { return mNotes.size(); }
+		inline const Note & getNote( const size_t i ) const { return mNotes[i]; }
+
+		// when the last note ends, in beats
+		double getLength() const;
+
+	private:
+		std::vector<Note>	mNotes;
+		bool				mSorted;
+	};
+
+	/**
+	 * Plays a Score on a VoicePool without handing all of it to the output's NoteManager at once.
+	 * The player schedules the notes that start within lookahead beats, then schedules itself
+	 * to run on the audio thread when the first note it didn't schedule should start and does
+	 * the same from there. So playing starts right away no matter how long the score is, and
+	 * how many notes are waiting to be played at any time depends on how dense the score is
+	 * over the lookahead, not on how long it is. There's no need to pause notes while it does this,
+	 * every note is scheduled relative to when the player itself ran, which is sample accurate.
+	 *
+	 * If the pool runs out of room for pending notes, the player tries again when the note
+	 * that didn't fit should start, and drops it if there still isn't room then.
+	 * Give the pool more pending notes or use a shorter lookahead if that happens.
+	 *
+	 * The Score must not be changed or destroyed while it plays. Destroy the player before the
+	 * pool and the output, once it has stopped playing, or after the output has been closed.
+	 */
+	class ScorePlayer
+	{
+	public:
+		ScorePlayer( AudioOutput & output, VoicePool & voices, const float lookahead = 1.f );
+		~ScorePlayer();
+
+		// start playing score startTime beats from now.
+		// returns false if we are still playing or the score isn't sorted.
+		bool play( const Score & score, const float startTime = 0 );
+
+		// stops scheduling notes, notes that are already scheduled will still play.
+		// we keep playing until the audio thread has seen this, which will be within lookahead beats.
+		void stop();
+		inline bool isPlaying() const { return mPlaying; }
+
+		inline void	 setLookahead( const float lookahead ) { mLookahead = lookahead; }
+		inline float getLookahead() const { return mLookahead; }
+
+		// how many notes were dropped because the pool was full, since play was last called.
+		inline int getDroppedNotes() const { return mDropped; }
+
+	private:
+
+		// what we schedule on the NoteManager to get called back on the audio thread.
+		class Feeder : public Instrument
+		{
+		public:
+			Feeder() : mPlayer(NULL) {}
+
+			virtual void noteOn( float duration );
+			virtual void noteOff() {}
+
+			ScorePlayer * mPlayer;
+		};
+		friend class Feeder;
+
+		// schedule everything in our lookahead and then ourselves, on the audio thread
+		void feed();
+
+		AudioOutput &		mOutput;
+		VoicePool &			mVoices;
+		std::atomic<float>	mLookahead;
+		Feeder				mFeeder;
+
+		// only touched by the audio thread while we are playing
+		const Score *		mScore;
+		size_t				mNext;
+		// where in the score the feeder is running, in beats
+		double				mBeat;
+
+		std::atomic<bool>	mPlaying;
+		std::atomic<bool>	mStopping;
+		std::atomic<int>	mDropped;
+	};
+}
+
+#endif // SCOREPLAYER_H
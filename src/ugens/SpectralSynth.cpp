@@ -0,0 +1,307 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "SpectralSynth.h"
+#include "Logging.h"
+
+#define  _USE_MATH_DEFINES // required in windows to get constants like M_PI
+#include <math.h>
+#include <stdio.h> // for snprintf
+#include <string.h> // for memset, memcpy
+
+namespace Minim
+{
+	// the four term Blackman-Harris window, whose sidelobes are 92 dB down
+	static const double kWindow[4] = { 0.35875, 0.48829, 0.14128, 0.01168 };
+
+	// the window centered on n = 0, for n in [-size/2, size/2)
+	static double centeredWindow( const int n, const int size )
+	{
+		const double x = 2 * M_PI * n / size;
+		return kWindow[0] + kWindow[1] * cos( x ) + kWindow[2] * cos( 2 * x ) + kWindow[3] * cos( 3 * x );
+	}
+
+	// the smallest FFT we'll synthesize with, so that a hop is at least a few samples
+	static const int kMinFFTSize = 16;
+
+	// the FFT has to be a power of two, round anything else up to one
+	static int validFFTSize( const int fftSize )
+	{
+		int size = kMinFFTSize;
+		while ( size < fftSize )
+		{
+			size *= 2;
+		}
+
+		if ( size != fftSize )
+		{
+			char msg[128];
+			snprintf( msg, sizeof(msg), "SpectralSynth: fftSize %d isn't a power of two of at least %d, using %d.", fftSize, kMinFFTSize, size );
+			Minim::error( msg );
+		}
+
+		return size;
+	}
+
+	SpectralSynth::SpectralSynth( const int numPartials, const int fftSize )
+	: UGen()
+	, amplitude( *this, CONTROL )
+	, mPartialCount( numPartials > 0 ? numPartials : 0 )
+	, mFFTSize( validFFTSize( fftSize ) )
+	, mHopSize( mFFTSize / 4 )
+	, mFFT( mFFTSize, 44100.f ) // the sample rate doesn't matter for inverse
+	, mKernel( 2 * kKernelHalfWidth * kKernelResolution + 2, 0.f )
+	, mSynthesisWindow( mFFTSize / 2, 0.f )
+	, mFrame( mFFTSize, 0.f )
+	, mOverlap( mFFTSize / 2, 0.f )
+	, mOutputIndex( mFFTSize / 4 )
+	, mFrequencies( mPartialCount, 0.f )
+	, mAmplitudes( mPartialCount, 0.f )
+	, mPhases( mPartialCount, 0.0 )
+	, mPendingFrequencies( mPartialCount, 0.f )
+	, mPendingAmplitudes( mPartialCount, 0.f )
+	, mPendingChanged( false )
+	, mPendingReset( false )
+	{
+		amplitude.setLastValue( 1.f );
+
+		// the spectrum of the window at fractional bin offsets. it is symmetric,
+		// so the real part is all there is, apart from a rounding error's worth.
+		for( int i = 0; i < (int)mKernel.size(); ++i )
+		{
+			const double offset = (double)i / kKernelResolution - kKernelHalfWidth;
+			double sum = 0;
+			for( int n = -mFFTSize / 2; n < mFFTSize / 2; ++n )
+			{
+				sum += centeredWindow( n, mFFTSize ) * cos( 2 * M_PI * offset * n / mFFTSize );
+			}
+			mKernel[i] = (float)sum;
+		}
+
+		// triangles a hop apart sum to one, the window is taken back out of the inverse FFT
+		for( int j = 0; j < 2 * mHopSize; ++j )
+		{
+			const int n = j - mHopSize;
+			const double triangle = 1.0 - (double)( n < 0 ? -n : n ) / mHopSize;
+			mSynthesisWindow[j] = (float)( triangle / centeredWindow( n, mFFTSize ) );
+		}
+	}
+
+	SpectralSynth::~SpectralSynth()
+	{
+	}
+
+	///////////////////////////////////////////////////
+	void SpectralSynth::setFrequencies( const float * frequencies, const int count, const int first )
+	{
+		std::lock_guard<std::mutex> lock( mPendingMutex );
+		for( int i = 0; i < count && first + i < mPartialCount; ++i )
+		{
+			mPendingFrequencies[first + i] = frequencies[i];
+		}
+		mPendingChanged = true;
+	}
+
+	///////////////////////////////////////////////////
+	void SpectralSynth::setAmplitudes( const float * amplitudes, const int count, const int first )
+	{
+		std::lock_guard<std::mutex> lock( mPendingMutex );
+		for( int i = 0; i < count && first + i < mPartialCount; ++i )
+		{
+			mPendingAmplitudes[first + i] = amplitudes[i];
+		}
+		mPendingChanged = true;
+	}
+
+	///////////////////////////////////////////////////
+	void SpectralSynth::setFrequency( const int partial, const float frequency )
+	{
+		setFrequencies( &frequency, 1, partial );
+	}
+
+	///////////////////////////////////////////////////
+	void SpectralSynth::setAmplitude( const int partial, const float partialAmplitude )
+	{
+		setAmplitudes( &partialAmplitude, 1, partial );
+	}
+
+	///////////////////////////////////////////////////
+	void SpectralSynth::setHarmonics( const float fundamental )
+	{
+		std::lock_guard<std::mutex> lock( mPendingMutex );
+		for( int i = 0; i < mPartialCount; ++i )
+		{
+			mPendingFrequencies[i] = fundamental * ( i + 1 );
+		}
+		mPendingChanged = true;
+	}
+
+	///////////////////////////////////////////////////
+	void SpectralSynth::reset()
+	{
+		mPendingReset = true;
+	}
+
+	///////////////////////////////////////////////////
+	void SpectralSynth::receive()
+	{
+		if ( mPendingReset.exchange( false ) )
+		{
+			for( int i = 0; i < mPartialCount; ++i )
+			{
+				mPhases[i] = 0;
+			}
+		}
+
+		if ( mPendingChanged && mPendingMutex.try_lock() )
+		{
+			mFrequencies = mPendingFrequencies;
+			mAmplitudes	 = mPendingAmplitudes;
+			mPendingChanged = false;
+			mPendingMutex.unlock();
+		}
+	}
+
+	///////////////////////////////////////////////////
+	float SpectralSynth::kernel( const float offset ) const
+	{
+		const float at	 = ( offset + kKernelHalfWidth ) * kKernelResolution;
+		const int	low	 = (int)at;
+		const float frac = at - low;
+		return mKernel[low] + ( mKernel[low + 1] - mKernel[low] ) * frac;
+	}
+
+	///////////////////////////////////////////////////
+	void SpectralSynth::synthesizeHop()
+	{
+		receive();
+
+		const int N = mFFTSize;
+		float * real = mFFT.getSpectrumReal();
+		float * imag = mFFT.getSpectrumImaginary();
+		memset( real, 0, sizeof(float) * N );
+		memset( imag, 0, sizeof(float) * N );
+
+		const float rate		 = sampleRate() > 0 ? sampleRate() : 44100.f;
+		const float binsPerHz	 = N / rate;
+		const float maxBin		 = N / 2 - kKernelHalfWidth;
+		const double hopSeconds	 = mHopSize / rate;
+
+		for( int p = 0; p < mPartialCount; ++p )
+		{
+			const float frequency = fabsf( mFrequencies[p] );
+			const float bin		  = frequency * binsPerHz;
+			const float amp		  = mAmplitudes[p];
+
+			if ( amp != 0.f && bin < maxBin )
+			{
+				// half goes at the positive frequency and half at the negative one
+				const double phase = 2 * M_PI * mPhases[p];
+				const float  c	   = 0.5f * amp * (float)cos( phase );
+				const float  s	   = 0.5f * amp * (float)sin( phase );
+
+				const int first = (int)ceilf( bin - kKernelHalfWidth );
+				const int last	= (int)floorf( bin + kKernelHalfWidth );
+				for( int k = first; k <= last; ++k )
+				{
+					const float weight = kernel( k - bin );
+					const int positive = k >= 0 ? k : k + N;
+					const int negative = k > 0 ? N - k : -k;
+					real[positive] += c * weight;
+					imag[positive] += s * weight;
+					real[negative] += c * weight;
+					imag[negative] -= s * weight;
+				}
+			}
+
+			// on to the center of the next frame
+			const double next = mPhases[p] + frequency * hopSeconds;
+			mPhases[p] = next - floor( next );
+		}
+
+		mFFT.inverse( &mFrame[0] );
+
+		// the inverse FFT is centered on its first sample, we use the hop either side of that
+		const int frameLength = 2 * mHopSize;
+		for( int j = 0; j < frameLength; ++j )
+		{
+			const int n = j - mHopSize;
+			mOverlap[j] += mFrame[ n >= 0 ? n : n + N ] * mSynthesisWindow[j];
+		}
+	}
+
+	///////////////////////////////////////////////////
+	void SpectralSynth::uGenerate( float * channels, const int numChannels )
+	{
+		if ( mOutputIndex == mHopSize )
+		{
+			// move what is left of the last frame to the front
+			memcpy( &mOverlap[0], &mOverlap[mHopSize], sizeof(float) * mHopSize );
+			memset( &mOverlap[mHopSize], 0, sizeof(float) * mHopSize );
+			synthesizeHop();
+			mOutputIndex = 0;
+		}
+
+		UGen::fill( channels, mOverlap[mOutputIndex++] * amplitude.getLastValue(), numChannels );
+	}
+
+	///////////////////////////////////////////////////
+	void SpectralSynth::uGenerateBlock( float ** channels, const int numChannels, const int numFrames )
+	{
+		float * out = channels[0];
+		int frame = 0;
+		while ( frame < numFrames )
+		{
+			if ( mOutputIndex == mHopSize )
+			{
+				memcpy( &mOverlap[0], &mOverlap[mHopSize], sizeof(float) * mHopSize );
+				memset( &mOverlap[mHopSize], 0, sizeof(float) * mHopSize );
+				synthesizeHop();
+				mOutputIndex = 0;
+			}
+
+			const int count = mHopSize - mOutputIndex < numFrames - frame ? mHopSize - mOutputIndex : numFrames - frame;
+			memcpy( out + frame, &mOverlap[mOutputIndex], sizeof(float) * count );
+			mOutputIndex += count;
+			frame += count;
+		}
+
+		float * const * amplitudeBlock = amplitude.getBlockValues();
+		if ( amplitudeBlock )
+		{
+			const float * amp = amplitudeBlock[0];
+			for( int f = 0; f < numFrames; ++f )
+			{
+				out[f] *= amp[f];
+			}
+		}
+		else
+		{
+			const float amp = amplitude.getLastValue();
+			for( int f = 0; f < numFrames; ++f )
+			{
+				out[f] *= amp;
+			}
+		}
+
+		for( int c = 1; c < numChannels; ++c )
+		{
+			memcpy( channels[c], out, sizeof(float) * numFrames );
+		}
+	}
+}
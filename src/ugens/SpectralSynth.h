@@ -0,0 +1,127 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef SPECTRALSYNTH_H
+#define SPECTRALSYNTH_H
+
+#include "UGen.h"
+#include "FFT.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace Minim
+{
+	/**
+	 * Additive synthesis for thousands of sine partials. Instead of running an oscillator
+	 * for every partial, like OscilBank does, it writes every partial into a spectrum
+	 * once per hop and turns that into sound with one inverse FFT, so the cost depends on
+	 * fftSize far more than on how many partials there are.
+	 *
+	 * Each partial goes into the spectrum as the spectrum of a Blackman-Harris window
+	 * centered on its frequency, nine bins wide, which is where nearly all of that window's
+	 * energy is. The inverse FFT is then the window times the sum of the partials. The
+	 * middle half of that, where the window is large, is divided by the window and
+	 * overlap-added with triangular windows a quarter of fftSize apart, so changes
+	 * to a partial crossfade over that many samples.
+	 *
+	 * Frequencies and amplitudes are set just like they are for OscilBank and take effect
+	 * with the next hop. Partials closer to Nyquist than the window is wide are skipped.
+	 * Output is delayed by a quarter of fftSize.
+	 *
+	 * The output is the same on every channel.
+	 */
+	class SpectralSynth : public UGen
+	{
+	public:
+		// fftSize should be a power of two of at least 16, 
+		// anything else is rounded up to one and reported with Minim::error.
+		SpectralSynth( const int numPartials, const int fftSize = 1024 );
+		virtual ~SpectralSynth();
+
+		// scales the sum of the partials
+		UGenInput amplitude;
+
+		inline int getPartialCount() const { return mPartialCount; }
+		inline int getFFTSize() const { return mFFTSize; }
+
+		// set count partials starting with first, in Hz and linear amplitude.
+		void setFrequencies( const float * frequencies, const int count, const int first = 0 );
+		void setAmplitudes( const float * amplitudes, const int count, const int first = 0 );
+		void setFrequency( const int partial, const float frequency );
+		void setAmplitude( const int partial, const float partialAmplitude );
+
+		// tune partial n to n+1 times fundamental
+		void setHarmonics( const float fundamental );
+
+		// start every partial at the beginning of its cycle with the next hop
+		void reset();
+
+	protected:
+		// UGen impl
+		virtual void uGenerate( float * channels, const int numChannels );
+		virtual void uGenerateBlock( float ** channels, const int numChannels, const int numFrames );
+
+	private:
+		// take what was set since the last hop, if we can without waiting
+		void receive();
+		// make the next mHopSize samples of output
+		void synthesizeHop();
+		// the spectrum of our window, offset bins from its center
+		float kernel( const float offset ) const;
+
+		enum
+		{
+			// how many bins either side of a partial's frequency it is written into
+			kKernelHalfWidth = 4,
+			// how many kernel values we keep per bin
+			kKernelResolution = 64
+		};
+
+		int					mPartialCount;
+		int					mFFTSize;
+		int					mHopSize;
+		FFT					mFFT;
+
+		// the window's spectrum from -kKernelHalfWidth to kKernelHalfWidth bins
+		std::vector<float>	mKernel;
+		// what to multiply the middle of each inverse FFT by, triangle / window
+		std::vector<float>	mSynthesisWindow;
+		// the inverse FFT of each hop
+		std::vector<float>	mFrame;
+		// output being overlap-added, the first half of it is done
+		std::vector<float>	mOverlap;
+		int					mOutputIndex;
+
+		// what the audio thread synthesizes with
+		std::vector<float>	mFrequencies;
+		std::vector<float>	mAmplitudes;
+		// in cycles, at the center of the next frame
+		std::vector<double>	mPhases;
+
+		// what has been set, waiting for the audio thread
+		std::vector<float>	mPendingFrequencies;
+		std::vector<float>	mPendingAmplitudes;
+		std::mutex			mPendingMutex;
+		std::atomic<bool>	mPendingChanged;
+		std::atomic<bool>	mPendingReset;
+	};
+}
+
+#endif // SPECTRALSYNTH_H
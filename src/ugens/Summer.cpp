@@ -17,8 +17,11 @@
  */
 
 #include "Summer.h"
+#include "UGenSchedule.h"
+#include "MixKernels.h"
 #include <string.h> // for memset, memcpy
 #include <cassert>
+#include <mutex>
 
 #ifndef NULL
 #define NULL 0
@@ -28,17 +31,22 @@ namespace Minim
 {
 	
 	// static int kUGensDefaultSize = 10;
+	
+	std::atomic<Summer::InputList*> Summer::s_retired( NULL );
+	std::atomic<unsigned int>		Summer::s_epoch( 0 );
+	std::atomic<int>				Summer::s_readers[2];
+	Summer::InputList *				Summer::s_pending = NULL;
+	
+	// held by whoever is in reclaim
+	static std::mutex sReclaimMutex;
 
 Summer::Summer()
 : UGen()
+, volume( *this, CONTROL )
+, m_inputs( new InputList(0) )
 , m_accum( new float[1] ) // assume mono, same as UGen
 , m_accumSize(1)
-, m_inputs(NULL)
-, m_inputsLength(16)
-, volume( *this, CONTROL )
 {
-	m_inputs = new UGen*[m_inputsLength];
-	memset( m_inputs, 0, sizeof(UGen*)*m_inputsLength );
 	volume.setLastValue( 1 );
 }
 	
@@ -49,31 +57,50 @@ Summer::~Summer()
 		delete [] m_accum;
 	}
 
-	if ( m_inputs )
+	// lists we swapped out are reclaimed along with everyone else's
+	delete m_inputs.load();
+} 
+	
+///////////////////////////////////////////////////
+Summer::InputListReader::InputListReader( const Summer & summer )
+{
+	// count ourselves in the current epoch before loading, so that a list we load can only 
+	// be retired in this epoch or a later one. if reclaim moved on while we were counting
+	// ourselves, we try again in the new one.
+	for(;;)
 	{
-		delete [] m_inputs;
+		mEpoch = s_epoch.load();
+		++s_readers[mEpoch & 1];
+		if ( s_epoch.load() == mEpoch )
+		{
+			break;
+		}
+		--s_readers[mEpoch & 1];
 	}
-} 
+	mList = summer.m_inputs.load();
+}
+	
+Summer::InputListReader::~InputListReader()
+{
+	--s_readers[mEpoch & 1];
+}
 	
 ///////////////////////////////////////////////////
 void Summer::sampleRateChanged()
 {
-    BMutexLock lock( m_mutex );
+	InputListReader list( *this );
     
-	for( int i = 0; i < m_inputsLength; ++i )
+	for( int i = 0; i < list->length; ++i )
 	{
-		if ( m_inputs[i] )
-		{
-			m_inputs[i]->setSampleRate( sampleRate() );
-		}
+		list->inputs[i]->setSampleRate( sampleRate() );
 	}
 }
 	
 ///////////////////////////////////////////////////
 void Summer::channelCountChanged()
 {
-    BMutexLock lock( m_mutex );
-    
+	// channel count is set when we are patched, before we are ticked, 
+	// so it's safe to swap out our accumulator here.
 	if ( m_accumSize < getAudioChannelCount() )
 	{
 		delete [] m_accum;
@@ -83,12 +110,11 @@ void Summer::channelCountChanged()
 	
 	m_accumSize = getAudioChannelCount();
 	
-	for( int i = 0; i < m_inputsLength; ++i )
+	InputListReader list( *this );
+	
+	for( int i = 0; i < list->length; ++i )
 	{
-		if ( m_inputs[i] )
-		{
-			m_inputs[i]->setAudioChannelCount( m_accumSize );
-		}
+		list->inputs[i]->setAudioChannelCount( m_accumSize );
 	}
 }
 	
@@ -98,85 +124,236 @@ void Summer::addInput( UGen * in )
     in->setSampleRate( sampleRate() );
     in->setAudioChannelCount( m_accumSize );
     
-	// find a free slot
-	for( int i = 0; i < m_inputsLength; ++i )
+	InputList * current = NULL;
 	{
-		if ( m_inputs[i] == NULL )
+		// count as a reader while we copy so that the list we are copying can't be deleted
+		InputListReader reading( *this );
+		
+		current				= m_inputs.load();
+		InputList * next	= NULL;
+		do
 		{
-			m_inputs[i] = in;
-			return;
+			// someone else changed the list since we last looked, start over
+			delete next;
+			
+			// copy the current list with the new input on the end
+			next = new InputList( current->length + 1 );
+			memcpy( next->inputs, current->inputs, sizeof(UGen*)*current->length );
+			next->inputs[current->length] = in;
 		}
+		while ( !publish( current, next ) );
 	}
-    
-    // lock if we have to mess with the list
-    BMutexLock lock( m_mutex );
-
-	// didn't find a slot, double the size of our list
-	const int newLength = m_inputsLength*2;
-	UGen** newList		= new UGen*[newLength];
-	// initialize
-	memset( newList, 0, sizeof(UGen*)*newLength );
-	// copy old list to new list
-	memcpy(newList, m_inputs, sizeof(UGen*)*m_inputsLength);
-	// add new input to end of the list
-	newList[m_inputsLength] = in;
-	// delete old list
-	delete [] m_inputs;
-	// use new list
-	m_inputsLength = newLength;
-	m_inputs	   = newList;	
+	
+	retire( current );
 }
 
 ///////////////////////////////////////////////
 void Summer::removeInput( UGen * in )
 {    
-    // simply nulls reference if pointers match
-    // this is so that UGens can be removed from the list
-    // while the Summer is ticking them. An example of 
-    // this happening is ADSR unpatching itself.
+    // this is safe to call while the Summer is ticking its inputs. 
+    // An example of this happening is ADSR unpatching itself.
+    // whoever is ticking keeps the old list until they are done with it,
+    // since it is only deleted by reclaim.
     
-	for( int i = 0; i < m_inputsLength; ++i )
+	InputList * current = NULL;
+	{
+		InputListReader reading( *this );
+		
+		current				= m_inputs.load();
+		InputList * next	= NULL;
+		do
+		{
+			delete next;
+			next = NULL;
+			
+			int index = 0;
+			while ( index < current->length && current->inputs[index] != in )
+			{
+				++index;
+			}
+			
+			// not one of ours
+			if ( index == current->length )
+			{
+				return;
+			}
+			
+			// copy everything except in
+			next = new InputList( current->length - 1 );
+			memcpy( next->inputs, current->inputs, sizeof(UGen*)*index );
+			memcpy( next->inputs + index, current->inputs + index + 1, sizeof(UGen*)*(current->length - index - 1) );
+		}
+		while ( !publish( current, next ) );
+	}
+	
+	retire( current );
+}
+	
+///////////////////////////////////////////////
+bool Summer::publish( InputList *& current, InputList * next )
+{
+	if ( m_inputs.compare_exchange_weak( current, next ) )
+	{
+		UGenSchedule::invalidate();
+		return true;
+	}
+	
+	return false;
+}
+	
+///////////////////////////////////////////////
+void Summer::retire( InputList * list )
+{
+	// readers that could still have it started in this epoch or before
+	list->epoch = s_epoch.load();
+	
+	list->nextRetired = s_retired.load();
+	while ( !s_retired.compare_exchange_weak( list->nextRetired, list ) ) {}
+}
+	
+///////////////////////////////////////////////
+void Summer::reclaim()
+{
+	std::unique_lock<std::mutex> lock( sReclaimMutex, std::try_to_lock );
+	if ( !lock.owns_lock() )
+	{
+		// someone else is already at it
+		return;
+	}
+	
+	InputList * retired = s_retired.exchange( NULL );
+	if ( retired )
 	{
-		if ( m_inputs[i] == in )
+		InputList * tail = retired;
+		while ( tail->nextRetired )
 		{
-			m_inputs[i] = NULL;
-			return;
+			tail = tail->nextRetired;
 		}
+		tail->nextRetired = s_pending;
+		s_pending = retired;
+	}
+	
+	if ( s_pending == NULL )
+	{
+		return;
+	}
+	
+	// readers from the previous epoch count on the same side as readers that start in the next one, 
+	// so we can't move on until they're done. until then, nothing retired in the previous epoch is safe.
+	const unsigned int epoch = s_epoch.load();
+	if ( s_readers[(epoch + 1) & 1].load() != 0 )
+	{
+		return;
 	}
+	
+	// everything retired before this epoch can go, since every reader that could be holding it has finished
+	InputList ** link = &s_pending;
+	while ( *link )
+	{
+		InputList * list = *link;
+		if ( list->epoch != epoch )
+		{
+			*link = list->nextRetired;
+			delete list;
+		}
+		else
+		{
+			link = &list->nextRetired;
+		}
+	}
+	
+	// and if anything is left, move on so that the readers of this epoch can finish by the next time we're called
+	if ( s_pending )
+	{
+		s_epoch.store( epoch + 1 );
+	}
+}
+	
+///////////////////////////////////////////////////
+void Summer::getInputUGens( std::vector<UGen*> & inputs )
+{
+    UGen::getInputUGens( inputs );
+    
+    InputListReader list( *this );
+    
+    m_scheduledInputs.assign( list->inputs, list->inputs + list->length );
+    
+    inputs.insert( inputs.end(), m_scheduledInputs.begin(), m_scheduledInputs.end() );
 }
     
 ///////////////////////////////////////////////////
 int Summer::inputCount() const
 {
-    int count = 0;
-    for( int i = 0; i < m_inputsLength; ++i )
+    InputListReader list( *this );
+    
+    return list->length;
+}
+
+///////////////////////////////////////////////////
+bool Summer::hasInput( const UGen * input ) const
+{
+    InputListReader list( *this );
+    
+    for( int i = 0; i < list->length; ++i )
     {
-        if ( m_inputs[i] )
+        if ( list->inputs[i] == input )
         {
-            ++count;
+            return true;
         }
     }
-    
-    return count;
+    return false;
 }
 
 ///////////////////////////////////////////////////
 void Summer::uGenerate(float * channels, const int numChannels)
 {	
-    BMutexLock lock( m_mutex );
+    InputListReader list( *this );
 
 	// start out with silence
     UGen::fill( channels, 0, numChannels );
 
     const float v = volume.getLastValue();
-	for( int i = 0; i < m_inputsLength; ++i )
+	for( int i = 0; i < list->length; ++i )
 	{
-		if ( m_inputs[i] )
-		{
-            m_inputs[i]->tick( m_accum, numChannels );
-            UGen::accum(channels, m_accum, numChannels, v);
-		}
+        list->inputs[i]->tick( m_accum, numChannels );
+        UGen::accum(channels, m_accum, numChannels, v);
 	}
 }
 
-} // namespace Minim
\ No newline at end of file
+///////////////////////////////////////////////////
+void Summer::uGenerateBlock(float ** channels, const int numChannels, const int numFrames)
+{
+    // no need to lock, m_scheduledInputs is only used from the audio thread
+    
+    // start out with silence
+    for( int c = 0; c < numChannels; ++c )
+    {
+        memset( channels[c], 0, sizeof(float)*numFrames );
+    }
+    
+    float * const * volumeBlock = volume.getBlockValues();
+    const float * v = volumeBlock ? volumeBlock[0] : NULL;
+    const float   vol = volume.getLastValue();
+    const int count = (int)m_scheduledInputs.size();
+    for( int i = 0; i < count; ++i )
+    {
+        // will be NULL if the input wasn't scheduled for this block
+        float * const * inChannels = getInputBlock( *m_scheduledInputs[i] );
+        if ( inChannels )
+        {
+            for( int c = 0; c < numChannels; ++c )
+            {
+                if ( v )
+                {
+                    MixKernels::accum( channels[c], inChannels[c], v, numFrames );
+                }
+                else
+                {
+                    MixKernels::accum( channels[c], inChannels[c], vol, numFrames );
+                }
+            }
+        }
+    }
+}
+
+} // namespace Minim
@@ -20,7 +20,9 @@
 #define SUMMER_H
 
 #include "UGen.h"
-#include "BMutex.hpp"
+
+#include <atomic>
+#include <vector>
 
 namespace Minim
 {
@@ -34,6 +36,14 @@ namespace Minim
 		UGenInput volume;
         
         int inputCount() const;
+        // whether input is patched to us right now
+        bool hasInput( const UGen * input ) const;
+        
+        // Frees the input lists of every Summer that were swapped out by patching and that 
+        // nobody can be reading anymore. The audio thread never frees them itself, instead
+        // AudioOutput's housekeeping thread calls this regularly. Call it from a thread other 
+        // than the audio thread now and then if you patch Summers that aren't under an AudioOutput.
+        static void reclaim();
 
 	protected:
 		
@@ -51,21 +61,84 @@ namespace Minim
 		
 		// override
 		virtual void channelCountChanged();
+		
+		// override so that everything in our list is scheduled before us.
+		// we also keep a copy of the list, which is what uGenerateBlock sums.
+		virtual void getInputUGens( std::vector<UGen*> & inputs );
 
 	public:
 		// UGen impl
 		virtual void uGenerate(float * channels, const int numChannels);
+		
+		// override
+		virtual void uGenerateBlock(float ** channels, const int numChannels, const int numFrames);
 
 	private:
-	
-		UGen** m_inputs;
-		int	   m_inputsLength;	
+		
+		// an immutable, densely packed list of the UGens patched to us.
+		// addInput and removeInput never change a list that has been published, 
+		// they build a new one and swap it in, so the audio thread can iterate 
+		// the current list without locking and only pays for live inputs.
+		struct InputList
+		{
+			explicit InputList( const int inLength )
+			: length(inLength)
+			, inputs( inLength ? new UGen*[inLength] : NULL )
+			, epoch(0)
+			, nextRetired(NULL)
+			{}
+			
+			~InputList() { delete [] inputs; }
+			
+			int			 length;
+			UGen **		 inputs;
+			// the epoch the list was swapped out in
+			unsigned int epoch;
+			// links lists that have been swapped out but might still be being read
+			InputList *	 nextRetired;
+		};
+		
+		// holds on to the current list for as long as it is in scope,
+		// lists swapped out in the meantime won't be deleted until it goes away.
+		// readers are counted by the epoch they started in, so that reclaim 
+		// only has to wait for the readers that started before a list was retired.
+		class InputListReader
+		{
+		public:
+			explicit InputListReader( const Summer & summer );
+			~InputListReader();
+			
+			inline const InputList * operator->() const { return mList; }
+			
+		private:
+			unsigned int	  mEpoch;
+			const InputList * mList;
+		};
+		friend class InputListReader;
+		
+		// swap in a new list if current is still the current list, otherwise current is updated.
+		bool publish( InputList *& current, InputList * next );
+		// put a list that was swapped out on the retired stack for reclaim to delete.
+		static void retire( InputList * list );
+		
+		std::atomic<InputList*>		  m_inputs;
+		
+		// lists that have been swapped out by any Summer, but not yet looked at by reclaim,
+		// and the ones reclaim has taken but can't delete yet.
+		static std::atomic<InputList*> s_retired;
+		static InputList *				 s_pending;
+		// the current epoch and how many readers started in an even or odd epoch are still reading
+		static std::atomic<unsigned int> s_epoch;
+		static std::atomic<int>			 s_readers[2];
+		
+		// the inputs we had when our schedule was built. summing these in uGenerateBlock,
+		// rather than m_inputs, means that a UGen that unpatches itself while generating 
+		// a block, like ADSR does, still has that block included in our sum.
+		std::vector<UGen*> m_scheduledInputs;
 		
 		// array we accumulate samples into when we do our summing
 		float * m_accum;
 		int     m_accumSize;
-
-        BMutex  m_mutex;
 		
 	};
 };
@@ -8,6 +8,7 @@
  */
 
 #include "TickRate.h"
+#include "UGenSchedule.h"
 #include <string.h> // for memset, memcpy
 
 namespace Minim
@@ -38,6 +39,19 @@ namespace Minim
 	{
 		m_pAudio = in;
 		m_pAudio->setAudioChannelCount( m_sampleFrameSize );		
+		UGenSchedule::invalidate();
+	}
+	
+	// override
+	void TickRate::getPrivateInputUGens( std::vector<UGen*> & inputs )
+	{
+		UGen::getPrivateInputUGens( inputs );
+		
+		// we tick our audio at our own rate, so it can't generate blocks
+		if ( m_pAudio )
+		{
+			inputs.push_back( m_pAudio );
+		}
 	}
 	
 	// override
@@ -46,6 +60,7 @@ namespace Minim
 		if ( m_pAudio == in )
 		{
 			m_pAudio = NULL;
+			UGenSchedule::invalidate();
 		}
 	}
 	
@@ -44,6 +44,7 @@ namespace Minim
 		virtual void sampleRateChanged();
 		virtual void channelCountChanged();
 		virtual void uGenerate( float * sampleFrame, const int numberOfChannels );
+		virtual void getPrivateInputUGens( std::vector<UGen*> & inputs );
 		
 	private:
 		UGen *  m_pAudio;
@@ -17,12 +17,14 @@
  */
 
 #include "UGen.h"
+#include "UGenSchedule.h"
 #include "Logging.h"
 #include "AudioOutput.h"
+#include "MixKernels.h"
 #include <stdio.h> // for sprintf
 #include <string.h> // for memcpy
-#include <algorithm> // for fill
 #include <cassert>
+#include <chrono>
 
 #ifndef NULL
 #define NULL 0
@@ -38,18 +40,27 @@ UGen::UGenInput::UGenInput( UGen & outerUGen, UGen::InputType inputType, float d
 , mIncoming(NULL)
 , mChannelCount(1)
 , mNextInput(NULL)
+, mControlRate(1)
+, mControlFramesLeft(-1)
+, mControlValue(0)
+, mControlTarget(0)
+, mControlStep(0)
+, mControlBlock(NULL)
+, mControlBlockSize(0)
+, mControlBlockData(NULL)
 {
     mNextInput         = mOuterUGen.mInputs;
 	mOuterUGen.mInputs = this;
 	
-	mLastValues = new float[1];
+	mLastValues = mInlineValues;
 	mLastValues[0] = defaultValue;
 }
 	
 ///////////////////////////////////////////////////
 UGen::UGenInput::~UGenInput()
 {
-	delete [] mLastValues;
+	allocateFrame( mLastValues, mInlineValues, 0 );
+	delete [] mControlBlockData;
 }
 
 ///////////////////////////////////////////////////
@@ -72,9 +83,7 @@ void UGen::UGenInput::setChannelCount( const int numChannels )
 {
 	if ( mChannelCount < numChannels )
 	{
-		delete [] mLastValues;
-		mLastValues = new float[numChannels];
-		memset(mLastValues, 0, sizeof(float)*numChannels);
+		mLastValues = allocateFrame( mLastValues, mInlineValues, numChannels );
 	}
 	
 	mChannelCount = numChannels;
@@ -88,6 +97,9 @@ void UGen::UGenInput::setChannelCount( const int numChannels )
 void UGen::UGenInput::setIncomingUGen(Minim::UGen* inUGen )
 {
     mIncoming = inUGen;
+    mControlFramesLeft = -1;
+    UGenSchedule::invalidate();
+    
     if ( mInputType == AUDIO )
     {
         if ( mIncoming )
@@ -99,23 +111,153 @@ void UGen::UGenInput::setIncomingUGen(Minim::UGen* inUGen )
         memset(mLastValues, 0, sizeof(float)*mChannelCount);
     }
 }
+    
+///////////////////////////////////////////////////
+void UGen::UGenInput::loadBlockFrame( const int frame )
+{
+    float * const * block = getBlockValues();
+    if ( block )
+    {
+        for( int c = 0; c < mChannelCount; ++c )
+        {
+            mLastValues[c] = block[c][frame];
+        }
+    }
+}
+    
+///////////////////////////////////////////////////
+float * const * UGen::UGenInput::getBlockValues() const
+{
+    if ( mIncoming && mControlRate > 1 )
+    {
+        return &mControlBlock;
+    }
+    return mIncoming ? mOuterUGen.getInputBlock( *mIncoming ) : NULL;
+}
+    
+///////////////////////////////////////////////////
+void UGen::UGenInput::setControlRate( const int numFrames )
+{
+    if ( mInputType != CONTROL )
+    {
+        Minim::error("Only CONTROL inputs can have a control rate.");
+        return;
+    }
+    
+    mControlRate = numFrames > 1 ? numFrames : 1;
+    mControlFramesLeft = -1;
+    
+    if ( mIncoming )
+    {
+        setSampleRate( mOuterUGen.sampleRate() );
+    }
+    
+    // the incoming UGen is either scheduled or ticked by us now
+    UGenSchedule::invalidate();
+}
+    
+///////////////////////////////////////////////////
+void UGen::UGenInput::tickControl()
+{
+    if ( mControlFramesLeft <= 0 )
+    {
+        if ( mControlFramesLeft < 0 )
+        {
+            // first value, nothing to interpolate from
+            mIncoming->tick( &mControlTarget, 1 );
+        }
+        
+        mControlValue = mControlTarget;
+        mIncoming->tick( &mControlTarget, 1 );
+        mControlStep  = (mControlTarget - mControlValue) / mControlRate;
+        mControlFramesLeft = mControlRate;
+    }
+    
+    mLastValues[0] = mControlValue;
+    mControlValue += mControlStep;
+    --mControlFramesLeft;
+}
+    
+///////////////////////////////////////////////////
+void UGen::UGenInput::generateControlBlock( const int numFrames )
+{
+    // the schedule lays out room for this with our UGen's block, 
+    // so this only allocates if we are generated by something that didn't.
+    if ( mControlBlockSize < numFrames )
+    {
+        setControlBlockStorage( NULL, 0 );
+        mControlBlockData = new float[numFrames];
+        mControlBlock     = mControlBlockData;
+        mControlBlockSize = numFrames;
+    }
+    
+    for( int i = 0; i < numFrames; ++i )
+    {
+        tickControl();
+        mControlBlock[i] = mLastValues[0];
+    }
+}
+
+///////////////////////////////////////////////////
+void UGen::UGenInput::setControlBlockStorage( float * block, const int numFrames )
+{
+    if ( mControlBlockData )
+    {
+        delete [] mControlBlockData;
+        mControlBlockData = NULL;
+    }
+    
+    mControlBlock     = block;
+    mControlBlockSize = numFrames;
+}
 
 ///////////////////////////////////////////////////
 UGen::UGen()
 : mInputs(NULL) 
 , mChannelCount(1) // assume mono
-, mLastValues( new float[mChannelCount] ) 
+, mLastValues( NULL ) 
 , mSampleRate(0)
 , mNumOutputs(0)
 , mCurrentTick(0)
+, mBlockChannels(NULL)
+, mBlockData(NULL)
+, mBlockChannelCount(0)
+, mBlockFrameCount(0)
+, mBlockStamp(0)
+, mScheduleVisit(0)
+, mScheduleIndex(0)
+, mScheduling(false)
+, mProfileNanoseconds(0)
+, mProfileFrames(0)
+, mProfileBlocks(0)
+, mProfilePeakNanoseconds(0)
 {
     // don't start with garbage
-    mLastValues[0] = 0;
+    mLastValues = allocateFrame( mLastValues, mInlineLastValues, mChannelCount );
 }
 		  
 UGen::~UGen()
 {	
-	delete [] mLastValues;
+	allocateFrame( mLastValues, mInlineLastValues, 0 );
+	setBlockStorage( NULL, 0, 0 );
+}
+
+///////////////////////////////////////////////////
+float * UGen::allocateFrame( float * frame, float * inlineValues, const int numChannels )
+{
+	if ( frame != inlineValues )
+	{
+		delete [] frame;
+	}
+	
+	if ( numChannels <= 0 )
+	{
+		return NULL;
+	}
+	
+	frame = numChannels <= kInlineChannels ? inlineValues : new float[numChannels];
+	memset(frame, 0, sizeof(float)*numChannels);
+	return frame;
 }
 
 ///////////////////////////////////////////////////
@@ -138,7 +280,7 @@ UGen & UGen::patch( UGenInput & connectToInput )
 
 	mNumOutputs += 1;
 	
-	setSampleRate( connectToInput.getOuterUGen().sampleRate() );
+	setSampleRate( connectToInput.getOuterUGen().sampleRate() / connectToInput.getControlRate() );
 
 	return connectToInput.getOuterUGen();
 }
@@ -228,6 +370,156 @@ void UGen::tick(float *channels, const int numChannels)
 	}
 }
 
+///////////////////////////////////////////////////
+void UGen::generateBlock( const int numFrames, const unsigned int blockStamp, const bool profile )
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point start = profile ? Clock::now() : Clock::time_point();
+	
+	allocateBlock( numFrames );
+	
+	// inputs with a control rate tick what's patched to them themselves
+	UGenInput * in = mInputs;
+	while ( in )
+	{
+		if ( in->isPatched() && in->getControlRate() > 1 )
+		{
+			in->generateControlBlock( numFrames );
+		}
+		in = in->next();
+	}
+	
+	// stamp first so that our inputs can tell if what they are patched to 
+	// has generated the same block that we are generating.
+	mBlockStamp = blockStamp;
+	
+	uGenerateBlock( mBlockChannels, mChannelCount, numFrames );
+	
+	if ( profile )
+	{
+		const long long nanos = (long long)std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - start ).count();
+		// we are the only writer while the block is generated, so these don't need to be read-modify-writes
+		mProfileNanoseconds.store( mProfileNanoseconds.load( std::memory_order_relaxed ) + nanos, std::memory_order_relaxed );
+		mProfileFrames.store( mProfileFrames.load( std::memory_order_relaxed ) + numFrames, std::memory_order_relaxed );
+		mProfileBlocks.store( mProfileBlocks.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+		if ( nanos > mProfilePeakNanoseconds.load( std::memory_order_relaxed ) )
+		{
+			mProfilePeakNanoseconds.store( nanos, std::memory_order_relaxed );
+		}
+	}
+}
+
+///////////////////////////////////////////////////
+UGen::Profile UGen::getProfile() const
+{
+	Profile profile;
+	profile.nanoseconds		= mProfileNanoseconds.load( std::memory_order_relaxed );
+	profile.frames			= mProfileFrames.load( std::memory_order_relaxed );
+	profile.blocks			= mProfileBlocks.load( std::memory_order_relaxed );
+	profile.peakNanoseconds = mProfilePeakNanoseconds.load( std::memory_order_relaxed );
+	return profile;
+}
+
+///////////////////////////////////////////////////
+void UGen::resetProfile()
+{
+	mProfileNanoseconds.store( 0 );
+	mProfileFrames.store( 0 );
+	mProfileBlocks.store( 0 );
+	mProfilePeakNanoseconds.store( 0 );
+}
+
+///////////////////////////////////////////////////
+void UGen::uGenerateBlock( float ** channels, const int numChannels, const int numFrames )
+{
+	for( int i = 0; i < numFrames; ++i )
+	{
+		UGenInput * in = mInputs;
+		while ( in )
+		{
+			in->loadBlockFrame( i );
+			in = in->next();
+		}
+		
+		uGenerate( mLastValues, numChannels );
+		
+		for( int c = 0; c < numChannels; ++c )
+		{
+			channels[c][i] = mLastValues[c];
+		}
+	}
+}
+
+///////////////////////////////////////////////////
+void UGen::getInputUGens( std::vector<UGen*> & inputs )
+{
+	UGenInput * in = mInputs;
+	while ( in )
+	{
+		// inputs with a control rate tick what's patched to them themselves
+		if ( in->isPatched() && in->getControlRate() == 1 )
+		{
+			inputs.push_back( in->getIncomingUGen() );
+		}
+		in = in->next();
+	}
+}
+
+///////////////////////////////////////////////////
+void UGen::getPrivateInputUGens( std::vector<UGen*> & inputs )
+{
+	UGenInput * in = mInputs;
+	while ( in )
+	{
+		if ( in->isPatched() && in->getControlRate() > 1 )
+		{
+			inputs.push_back( in->getIncomingUGen() );
+		}
+		in = in->next();
+	}
+}
+
+///////////////////////////////////////////////////
+float * const * UGen::getInputBlock( const UGen & input ) const
+{
+	return input.mBlockStamp == mBlockStamp ? input.mBlockChannels : NULL;
+}
+
+///////////////////////////////////////////////////
+void UGen::allocateBlock( const int numFrames )
+{
+	if ( mBlockChannelCount != mChannelCount || mBlockFrameCount < numFrames )
+	{
+		setBlockStorage( NULL, 0, 0 );
+		
+		mBlockChannelCount = mChannelCount;
+		mBlockFrameCount   = numFrames;
+		mBlockData         = new float[mBlockChannelCount*mBlockFrameCount];
+		mBlockChannels     = new float*[mBlockChannelCount];
+		memset(mBlockData, 0, sizeof(float)*mBlockChannelCount*mBlockFrameCount);
+		
+		for( int c = 0; c < mBlockChannelCount; ++c )
+		{
+			mBlockChannels[c] = mBlockData + c*mBlockFrameCount;
+		}
+	}
+}
+
+///////////////////////////////////////////////////
+void UGen::setBlockStorage( float ** channels, const int numChannels, const int numFrames )
+{
+	if ( mBlockData )
+	{
+		delete [] mBlockChannels;
+		delete [] mBlockData;
+		mBlockData = NULL;
+	}
+	
+	mBlockChannels     = channels;
+	mBlockChannelCount = numChannels;
+	mBlockFrameCount   = numFrames;
+}
+
 /////////////////////////////////////////////////////
 void UGen::setSampleRate(float newSampleRate)
 {
@@ -257,9 +549,7 @@ void UGen::setAudioChannelCount( int numberOfChannels )
 	{
 		if ( mChannelCount < numberOfChannels )
 		{
-			delete [] mLastValues;
-			mLastValues = new float[numberOfChannels];
-			memset(mLastValues, 0, sizeof(float)*numberOfChannels);
+			mLastValues = allocateFrame( mLastValues, mInlineLastValues, numberOfChannels );
 		}
 		
 		mChannelCount = numberOfChannels;
@@ -308,7 +598,7 @@ void UGen::fill( float * sampleFrame, const float value, const int numChannels )
 			break;
 			
 		default:
-			std::fill(sampleFrame, sampleFrame + numChannels, value );
+			MixKernels::fill( sampleFrame, value, numChannels );
 			break;
 	}
 }
@@ -328,10 +618,7 @@ void UGen::accum( float * accumFrame, const float * sampleFrame, const int numCh
             break;
             
         default:
-            for( int c = 0; c < numChannels; ++c )
-            {
-                accumFrame[c] += sampleFrame[c] * scale;
-            }
+            MixKernels::accum( accumFrame, sampleFrame, scale, numChannels );
             break;
     }
 }
@@ -19,6 +19,9 @@
 #ifndef UGEN_H
 #define UGEN_H
 
+#include <atomic>
+#include <vector>
+
 #ifndef NULL
 #define NULL 0
 #endif
@@ -27,6 +30,7 @@ namespace Minim
 {
 
 	class AudioOutput;
+	class UGenSchedule;
 /**
  * The UGen class is an abstract class which is intended to be the basis for
  * all UGens in Minim.  
@@ -42,6 +46,10 @@ protected:
 	// jam3: enum is automatically static so it can't be in the nested class
 	enum InputType { CONTROL, AUDIO };
 	
+	// last values for this many channels are kept inside the UGen or UGenInput,
+	// so mono and stereo ones don't need their own allocations.
+	enum { kInlineChannels = 2 };
+	
 	/**
 	 * This inner class, UGenInput, is used to connect the output of other UGens to this UGen
 	 * @author Anderson Mills
@@ -58,12 +66,50 @@ protected:
 		inline bool isPatched() const { return mIncoming != 0; }
         
         // returns next input in the list, if there is one
-		inline UGenInput* tick() { if ( mIncoming ) mIncoming->tick(mLastValues, mChannelCount); return mNextInput; }
+		inline UGenInput* tick() 
+		{ 
+			if ( mIncoming ) 
+			{
+				if ( mControlRate > 1 ) tickControl(); 
+				else mIncoming->tick(mLastValues, mChannelCount); 
+			}
+			return mNextInput; 
+		}
         
         // for when we just need to iterate
         inline UGenInput* next() { return mNextInput; }
+        
+        // copies one sample frame of the block the incoming UGen generated for the current block
+        // into our last values, so that per-frame code can keep using getLastValue(s). 
+        // does nothing if not patched or if the incoming UGen has not generated the current block.
+        void loadBlockFrame( const int frame );
+		
+		// the incoming UGen runs at our control rate, so it gets a fraction of the sample rate.
+		inline void setSampleRate( float sampleRate ) { mIncoming->setSampleRate(sampleRate / mControlRate); }
+		
+		/**
+		 * Only evaluate what is patched to this input once every numFrames sample frames, 
+		 * linearly interpolating between those values in between. This is only allowed for
+		 * CONTROL inputs. Something like a vibrato LFO patched to an Oscil's frequency rarely 
+		 * needs to be evaluated every sample, so a rate of 16, 32, or 64 saves most of its cost.
+		 * To interpolate, the input evaluates what is patched one control period ahead.
+		 * The default is 1, which evaluates every sample frame.
+		 *
+		 * What is patched to an input with a control rate is ticked privately by the input,
+		 * at the sample rate divided by numFrames, so it should not be patched anywhere else.
+		 * If it is, the AudioOutput falls back to ticking its whole graph one sample frame
+		 * at a time, see UGenSchedule.
+		 */
+		void setControlRate( const int numFrames );
+		inline int getControlRate() const { return mControlRate; }
 		
-		inline void setSampleRate( float sampleRate ) { mIncoming->setSampleRate(sampleRate); }
+		// generates a block of interpolated values from the incoming UGen, 
+		// used instead of a scheduled block when we have a control rate.
+		void generateControlBlock( const int numFrames );
+		
+		// used by UGenSchedule to put our control block in its arena, block is numFrames samples.
+		// like UGen::setBlockStorage, the schedule owns that memory, but we free our own.
+		void setControlBlockStorage( float * block, const int numFrames );
 		
         void setIncomingUGen( UGen * inUGen );
 		
@@ -82,15 +128,37 @@ protected:
 		inline float getLastValue() const { return mLastValues[0]; }
 		// typically used to set the value of a CONTROL input directly if nothing is patched to it.
 		inline void setLastValue( const float val ) { mLastValues[0] = val; }
+		
+		// the planar block generated by the incoming UGen for the block our UGen is generating,
+		// use getChannelCount() as the number of channels. returns NULL if not patched or if 
+		// the incoming UGen was patched after the current block was scheduled.
+		float * const * getBlockValues() const;
 	
 	private:
 		
+		// advances our control rate interpolation by one sample frame, 
+		// ticking the incoming UGen if it's time for a new value.
+		void tickControl();
+		
 		UGen & mOuterUGen;
 		UGen * mIncoming;
 		InputType mInputType;
 		int mChannelCount;
-		float * mLastValues; // set based on channel count.
+		float * mLastValues; // set based on channel count, points at mInlineValues when they fit.
+		float mInlineValues[kInlineChannels];
         UGenInput* mNextInput; // who is the next input in the list?
+		
+		// control rate state, see setControlRate
+		int     mControlRate;
+		int     mControlFramesLeft; // until we need a new value, -1 when we don't have one yet
+		float   mControlValue;
+		float   mControlTarget;
+		float   mControlStep;
+		float * mControlBlock;
+		int     mControlBlockSize;
+		// the memory mControlBlock points into, if we allocated it ourselves.
+		// NULL when it points into the arena of a UGenSchedule.
+		float * mControlBlockData;
 	};  // ends the UGenInput inner class
 	
 public:
@@ -174,6 +242,41 @@ protected:
 	 */
 	virtual void uGenerate(float * channels, const int numChannels) = 0;
 	
+	/**
+	 * Override this method to generate a whole block of sample frames at once.
+	 * This is called by the UGenSchedule of the AudioOutput we are patched to,
+	 * which makes sure that everything patched to us has already generated the 
+	 * block, so their samples can be read with UGenInput::getBlockValues.
+	 *
+	 * @param channels
+	 *    planar output, numChannels arrays that are each numFrames long.
+	 *
+	 * The default implementation calls uGenerate once per sample frame, 
+	 * so UGens that only implement uGenerate still work when ticked in blocks.
+	 */
+	virtual void uGenerateBlock( float ** channels, const int numChannels, const int numFrames );
+	
+	/**
+	 * Adds all of the UGens that need to generate a block before we do to inputs.
+	 * The default implementation adds what is patched to our UGenInputs, except for 
+	 * inputs with a control rate, which tick what's patched to them privately. 
+	 * UGens that tick a UGen privately, like TickRate, should not add it either,
+	 * but add it in getPrivateInputUGens instead.
+	 */
+	virtual void getInputUGens( std::vector<UGen*> & inputs );
+	
+	/**
+	 * Adds all of the UGens that we tick ourselves, with tick(), instead of reading their block.
+	 * The default implementation adds what is patched to inputs with a control rate.
+	 * UGens that tick what is patched to them at a rate of their own, like TickRate, add that.
+	 * UGenSchedule uses this to make sure nothing ticked this way is generated from anywhere else.
+	 */
+	virtual void getPrivateInputUGens( std::vector<UGen*> & inputs );
+	
+	// the block input generated for the block we are generating, 
+	// or NULL if input has not generated it (because it was patched after scheduling).
+	float * const * getInputBlock( const UGen & input ) const;
+	
 public:
 	
 	// Just return the lastValues
@@ -181,6 +284,13 @@ public:
 	{
 		return mLastValues;
 	}
+	
+	// the planar block generated by the most recent block we were scheduled for.
+	// the memory belongs to the schedule, so this is only good while we are patched to something being rendered.
+	inline float * const * getBlockValues() const
+	{
+		return mBlockChannels;
+	}
 
 protected:
 	
@@ -252,20 +362,81 @@ public:
 	void printInputs() const;
     
     bool isPatched() const { return mNumOutputs > 0; }
+	
+	/**
+	 * How much time this UGen has spent generating blocks while profiling was turned on
+	 * for the AudioOutput it is patched to (see AudioOutput::setProfiling). Only our own 
+	 * time is counted, the UGens patched to us are timed separately, except for the ones 
+	 * we tick privately, like what is patched to an input with a control rate. 
+	 * For a Summer, this is the time it spends mixing its inputs.
+	 * Safe to call from any thread, the fields are read one at a time, 
+	 * so they might be off by a block from one another.
+	 */
+	struct Profile
+	{
+		long long nanoseconds;		// spent generating, in total
+		long long frames;			// sample frames generated in that time
+		long long blocks;			// blocks generated in that time
+		long long peakNanoseconds;	// the most spent generating one block
+	};
+	
+	Profile getProfile() const;
+	void resetProfile();
 
 private:
+	friend class UGenSchedule;
+	// so that it can take UGenInputs in its commands
+	friend class AudioOutput;
+	
+	// called by UGenSchedule once everything we depend on has generated this block,
+	// timing it when profile is true.
+	void generateBlock( const int numFrames, const unsigned int blockStamp, const bool profile = false );
+	
+	// makes sure our block buffer can hold numFrames of all our channels,
+	// allocating our own if the memory UGenSchedule gave us doesn't fit anymore.
+	void allocateBlock( const int numFrames );
+	
+	// used by UGenSchedule to put our block in its arena, channels is numChannels pointers 
+	// to numFrames samples each. the schedule owns that memory, so we forget about it
+	// when it's replaced, but free our own.
+	void setBlockStorage( float ** channels, const int numChannels, const int numFrames );
+	
+	// returns storage for the values of one sample frame of numChannels, 
+	// using inlineValues when they fit. frame was previously returned by this.
+	static float * allocateFrame( float * frame, float * inlineValues, const int numChannels );
+	
 	// all of this UGen's inputs, accessible in linked-list fashion
 	UGenInput *     mInputs;
     // how many last values were generated most recently
 	int             mChannelCount;
-    // last values generated by this UGen
+    // last values generated by this UGen, points at mInlineLastValues when they fit
 	float *         mLastValues;
+	float           mInlineLastValues[kInlineChannels];
 	// sampleRate of this UGen
 	float           mSampleRate;
 	// number of outputs connected to this UGen
 	int             mNumOutputs;
 	// counter for the currentTick with respect to the number of Outputs
 	int             mCurrentTick;
+	// planar sample frames generated by the most recent tickBlock
+	float **        mBlockChannels;
+	// the memory the block channels point into, if we allocated it ourselves.
+	// NULL when they point into the arena of a UGenSchedule.
+	float *         mBlockData;
+	// how many channels and frames mBlockData was allocated for
+	int             mBlockChannelCount;
+	int             mBlockFrameCount;
+	// which block mBlockChannels contains, assigned by UGenSchedule
+	unsigned int    mBlockStamp;
+	// used by UGenSchedule when sorting the graph
+	unsigned int    mScheduleVisit;
+	int             mScheduleIndex;
+	bool            mScheduling;
+	// see getProfile, written by whichever thread generated our last block
+	std::atomic<long long> mProfileNanoseconds;
+	std::atomic<long long> mProfileFrames;
+	std::atomic<long long> mProfileBlocks;
+	std::atomic<long long> mProfilePeakNanoseconds;
 };
 
 };
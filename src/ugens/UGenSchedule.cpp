@@ -0,0 +1,417 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "UGenSchedule.h"
+#include "Logging.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+namespace Minim
+{
+	// starts at one so that a new schedule will always build before its first render
+	std::atomic<unsigned int> UGenSchedule::sVersion(1);
+	std::atomic<unsigned int> UGenSchedule::sVisitCount(0);
+	std::atomic<unsigned int> UGenSchedule::sBlockCount(0);
+	
+	UGenSchedule::UGenSchedule( UGen & root )
+	: mRoot(root)
+	, mHasFeedback(false)
+	, mTickFrames(false)
+	, mBlockFrames(0)
+	, mBlockStamp(0)
+	, mBlockProfiling(false)
+	, mProfiling(false)
+	, mPool(NULL)
+	, mPoolInUse(NULL)
+	, mVersion(0)
+	, mArenaMemory(NULL)
+	, mArena(NULL)
+	, mArenaCapacity(0)
+	, mArenaFrames(0)
+	{
+	}
+	
+	UGenSchedule::~UGenSchedule()
+	{
+		// any UGen we shared with another schedule would still be pointing into our arena
+		invalidate();
+		delete [] mArenaMemory;
+	}
+	
+	///////////////////////////////////////////////////
+	void UGenSchedule::invalidate()
+	{
+		++sVersion;
+	}
+	
+	///////////////////////////////////////////////////
+	void UGenSchedule::render( const int numFrames )
+	{
+		// read the version before building so that any patching 
+		// that happens while we build will trigger another build next block.
+		const unsigned int version = sVersion.load();
+		if ( version != mVersion )
+		{
+			mVersion = version;
+			build();
+			mArenaFrames = 0;
+		}
+		
+		if ( numFrames > mArenaFrames )
+		{
+			layoutBlocks( numFrames );
+		}
+		
+		const unsigned int blockStamp = ++sBlockCount;
+		const bool profile = mProfiling.load();
+		
+		// let setThreadPool know we are using this pool, 
+		// checking that it wasn't swapped out before we could say so.
+		RenderThreadPool * pool = NULL;
+		do
+		{
+			pool = mPool.load();
+			mPoolInUse.store( pool );
+		}
+		while ( pool != mPool.load() );
+		
+		const int taskCount = (int)mTaskStart.size() - 1;
+		if ( mTickFrames )
+		{
+			const int channelCount = mRoot.mChannelCount;
+			float ** channels = mRoot.mBlockChannels;
+			for( int i = 0; i < numFrames; ++i )
+			{
+				mRoot.tick( &mFrame[0], channelCount );
+				for( int c = 0; c < channelCount; ++c )
+				{
+					channels[c][i] = mFrame[c];
+				}
+			}
+			mRoot.mBlockStamp = blockStamp;
+		}
+		else if ( pool && taskCount > 1 && !mHasFeedback )
+		{
+			for( size_t i = 0; i < mShared.size(); ++i )
+			{
+				mShared[i]->generateBlock( numFrames, blockStamp, profile );
+			}
+			
+			mBlockFrames = numFrames;
+			mBlockStamp  = blockStamp;
+			mBlockProfiling = profile;
+			pool->run( &UGenSchedule::renderTask, this, taskCount );
+			
+			mRoot.generateBlock( numFrames, blockStamp, profile );
+		}
+		else
+		{
+			const size_t count = mOrder.size();
+			for( size_t i = 0; i < count; ++i )
+			{
+				mOrder[i]->generateBlock( numFrames, blockStamp, profile );
+			}
+		}
+		
+		mPoolInUse.store( NULL );
+	}
+	
+	///////////////////////////////////////////////////
+	void UGenSchedule::renderTask( void * userData, const int task )
+	{
+		UGenSchedule & schedule = *static_cast<UGenSchedule*>(userData);
+		const size_t end = schedule.mTaskStart[task+1];
+		for( size_t i = schedule.mTaskStart[task]; i < end; ++i )
+		{
+			schedule.mTaskUGens[i]->generateBlock( schedule.mBlockFrames, schedule.mBlockStamp, schedule.mBlockProfiling );
+		}
+	}
+	
+	///////////////////////////////////////////////////
+	RenderThreadPool * UGenSchedule::setThreadPool( RenderThreadPool * pool )
+	{
+		RenderThreadPool * previous = mPool.exchange( pool );
+		while ( previous && mPoolInUse.load() == previous )
+		{
+			std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+		}
+		return previous;
+	}
+	
+	///////////////////////////////////////////////////
+	void UGenSchedule::build()
+	{
+		mOrder.clear();
+		mStack.clear();
+		mPending.clear();
+		mEdges.clear();
+		mEdgeStart.clear();
+		mHasFeedback = false;
+		
+		const unsigned int visit = ++sVisitCount;
+		push( &mRoot, visit );
+		
+		while( !mStack.empty() )
+		{
+			Visit & top = mStack.back();
+			if ( top.next < top.end )
+			{
+				UGen * in = mPending[top.next++];
+				if ( in->mScheduleVisit != visit )
+				{
+					push( in, visit );
+				}
+				else if ( in->mScheduling )
+				{
+					// in is still waiting on its own inputs, so this is a feedback loop.
+					// whoever reads from in won't get a block from it and keeps its last values.
+					Minim::debug("UGenSchedule found a feedback loop in the UGen graph.");
+					mHasFeedback = true;
+				}
+			}
+			else
+			{
+				// everything this ugen depends on is in the list, so it can go next
+				UGen * ugen = top.ugen;
+				ugen->mScheduling	 = false;
+				ugen->mScheduleIndex = (int)mOrder.size();
+				mEdgeStart.push_back( mEdges.size() );
+				mEdges.insert( mEdges.end(), mPending.begin() + top.begin, mPending.begin() + top.end );
+				mPending.resize( top.begin );
+				mStack.pop_back();
+				mOrder.push_back( ugen );
+			}
+		}
+		mEdgeStart.push_back( mEdges.size() );
+		
+		mTickFrames = findPrivateConflicts( visit );
+		
+		partition();
+	}
+	
+	///////////////////////////////////////////////////
+	bool UGenSchedule::findPrivateConflicts( const unsigned int visit )
+	{
+		// everything that a UGen ticks privately gets ticked through UGen::tick, all the way down,
+		// so it belongs to that one private input. we mark each one with the input it belongs to.
+		const unsigned int privateVisit = ++sVisitCount;
+		int privateInput = 0;
+		
+		std::vector<UGen*> & stack = mPending;
+		for( size_t i = 0; i < mOrder.size(); ++i )
+		{
+			stack.clear();
+			mOrder[i]->getPrivateInputUGens( stack );
+			
+			// each one is a separate private input, even when they belong to the same UGen
+			const size_t inputCount = stack.size();
+			for( size_t p = 0; p < inputCount; ++p )
+			{
+				++privateInput;
+				const size_t base = stack.size();
+				stack.push_back( stack[p] );
+				while ( stack.size() > base )
+				{
+					UGen * ugen = stack.back();
+					stack.pop_back();
+					
+					if ( ugen->mScheduleVisit == visit 
+						|| ( ugen->mScheduleVisit == privateVisit && ugen->mScheduleIndex != privateInput ) )
+					{
+						Minim::debug("UGenSchedule found a UGen that is ticked privately and from somewhere else, ticking the graph one sample frame at a time.");
+						stack.clear();
+						return true;
+					}
+					
+					if ( ugen->mScheduleVisit != privateVisit )
+					{
+						ugen->mScheduleVisit = privateVisit;
+						ugen->mScheduleIndex = privateInput;
+						ugen->getInputUGens( stack );
+						ugen->getPrivateInputUGens( stack );
+					}
+				}
+			}
+		}
+		
+		stack.clear();
+		return false;
+	}
+	
+	///////////////////////////////////////////////////
+	void UGenSchedule::partition()
+	{
+		static const int kUnowned = -1;
+		static const int kShared  = -2;
+		
+		const int count = (int)mOrder.size();
+		const int root  = count - 1;
+		
+		mOwner.assign( count, kUnowned );
+		mShared.clear();
+		mTaskUGens.clear();
+		mTaskStart.clear();
+		
+		// each input of the root starts its own task
+		int taskCount = 0;
+		for( size_t e = mEdgeStart[root]; e < mEdgeStart[root+1]; ++e )
+		{
+			const int in = mEdges[e]->mScheduleIndex;
+			if ( mOwner[in] == kUnowned )
+			{
+				mOwner[in] = taskCount++;
+			}
+		}
+		
+		// walk backwards so that everything that depends on a UGen has been seen before it is.
+		// a UGen belongs to a task if everything that depends on it does, otherwise it's shared.
+		for( int i = root - 1; i >= 0; --i )
+		{
+			const int owner = mOwner[i];
+			for( size_t e = mEdgeStart[i]; e < mEdgeStart[i+1]; ++e )
+			{
+				const int in = mEdges[e]->mScheduleIndex;
+				// skip feedback connections
+				if ( in >= i )
+				{
+					continue;
+				}
+				
+				if ( mOwner[in] == kUnowned )
+				{
+					mOwner[in] = owner;
+				}
+				else if ( mOwner[in] != owner )
+				{
+					mOwner[in] = kShared;
+				}
+			}
+		}
+		
+		// count up the size of each task so we can lay them out end to end, keeping schedule order.
+		mTaskStart.assign( taskCount + 1, 0 );
+		for( int i = 0; i < root; ++i )
+		{
+			if ( mOwner[i] >= 0 )
+			{
+				++mTaskStart[ mOwner[i] + 1 ];
+			}
+		}
+		for( int t = 0; t < taskCount; ++t )
+		{
+			mTaskStart[t+1] += mTaskStart[t];
+		}
+		
+		mTaskUGens.resize( mTaskStart[taskCount] );
+		// where the next UGen of each task goes
+		std::vector<size_t> fill( mTaskStart.begin(), mTaskStart.end() - 1 );
+		for( int i = 0; i < root; ++i )
+		{
+			if ( mOwner[i] >= 0 )
+			{
+				mTaskUGens[ fill[ mOwner[i] ]++ ] = mOrder[i];
+			}
+			else
+			{
+				mShared.push_back( mOrder[i] );
+			}
+		}
+	}
+	
+	///////////////////////////////////////////////////
+	void UGenSchedule::layoutBlocks( const int numFrames )
+	{
+		static const size_t kLineSize = 64;
+		static const size_t kFloatsPerLine = kLineSize / sizeof(float);
+		
+		// round up so that every channel starts on a new cache line
+		const size_t frames = ( numFrames + kFloatsPerLine - 1 ) / kFloatsPerLine * kFloatsPerLine;
+		
+		// each input with a control rate gets a channel for its control block after the blocks of its UGen
+		size_t channelCount = 0;
+		for( size_t i = 0; i < mOrder.size(); ++i )
+		{
+			channelCount += mOrder[i]->mChannelCount;
+			
+			for( UGen::UGenInput * in = mOrder[i]->mInputs; in; in = in->next() )
+			{
+				if ( in->isPatched() && in->getControlRate() > 1 )
+				{
+					++channelCount;
+				}
+			}
+		}
+		
+		const size_t size = channelCount * frames;
+		if ( size > mArenaCapacity )
+		{
+			// UGens that were in the last layout but aren't in this one still point into the old arena, 
+			// but they won't be asked for their block until a schedule lays them out again.
+			delete [] mArenaMemory;
+			mArenaMemory   = new float[ size + kFloatsPerLine ];
+			mArena         = reinterpret_cast<float*>( ( reinterpret_cast<uintptr_t>( mArenaMemory ) + kLineSize - 1 ) & ~(uintptr_t)( kLineSize - 1 ) );
+			mArenaCapacity = size;
+		}
+		memset( mArena, 0, sizeof(float) * size );
+		
+		mArenaChannels.resize( channelCount );
+		size_t channel = 0;
+		for( size_t i = 0; i < mOrder.size(); ++i )
+		{
+			UGen * ugen = mOrder[i];
+			float ** channels = mArenaChannels.data() + channel;
+			for( int c = 0; c < ugen->mChannelCount; ++c, ++channel )
+			{
+				mArenaChannels[channel] = mArena + channel * frames;
+			}
+			ugen->setBlockStorage( channels, ugen->mChannelCount, (int)frames );
+			
+			for( UGen::UGenInput * in = ugen->mInputs; in; in = in->next() )
+			{
+				if ( in->isPatched() && in->getControlRate() > 1 )
+				{
+					mArenaChannels[channel] = mArena + channel * frames;
+					in->setControlBlockStorage( mArenaChannels[channel], (int)frames );
+					++channel;
+				}
+			}
+		}
+		
+		mFrame.resize( mRoot.mChannelCount );
+		mArenaFrames = (int)frames;
+	}
+	
+	///////////////////////////////////////////////////
+	void UGenSchedule::push( UGen * ugen, const unsigned int visit )
+	{
+		ugen->mScheduleVisit = visit;
+		ugen->mScheduling	 = true;
+		
+		Visit v;
+		v.ugen  = ugen;
+		v.begin = mPending.size();
+		ugen->getInputUGens( mPending );
+		v.next  = v.begin;
+		v.end   = mPending.size();
+		
+		mStack.push_back( v );
+	}
+}
@@ -0,0 +1,170 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef UGENSCHEDULE_H
+#define UGENSCHEDULE_H
+
+#include "UGen.h"
+#include "RenderThreadPool.h"
+
+#include <atomic>
+#include <vector>
+
+namespace Minim
+{
+	/**
+	 * A UGenSchedule is the flattened version of all the UGens that a root UGen depends on,
+	 * sorted so that every UGen comes after everything that is patched to it. Rendering a block
+	 * walks this list once, so each UGen generates the block exactly once, no matter how many 
+	 * outputs it has. The list is only rebuilt when the patching of any UGen has changed.
+	 * AudioOutput keeps one of these for its Summer.
+	 *
+	 * When given a RenderThreadPool, the UGens that only one input of the root depends on 
+	 * are grouped into one task per input, and those tasks are rendered in parallel.
+	 * UGens that more than one input depends on, like an LFO shared by two voices, are rendered
+	 * before the tasks start. Because every UGen still generates into its own block and the 
+	 * root sums its inputs in the same order, the output is identical to rendering serially, 
+	 * as long as UGens don't share state behind the graph's back (Noise uses rand(), 
+	 * so several Noise UGens rendered in parallel will not get the same sequence).
+	 * Graphs with feedback loops are always rendered serially.
+	 *
+	 * UGens that are ticked privately, like what is patched to a TickRate or to an input 
+	 * with a control rate, aren't in the schedule. They are generated by whoever ticks them, 
+	 * which is also who they are rendered with in parallel. If one of them is also scheduled,
+	 * or ticked privately from more than one place, generating blocks would tick it more than 
+	 * once per sample frame, so the whole graph is ticked one sample frame at a time instead, 
+	 * the way it was before there were schedules.
+	 *
+	 * The blocks of all the UGens in the schedule are kept end to end in one arena, 
+	 * in schedule order, with each channel starting on its own cache line. So a UGen's 
+	 * block is usually right next to the blocks of the UGens patched to it, 
+	 * and UGens rendered by different threads never write to the same cache line.
+	 */
+	class UGenSchedule
+	{
+	public:
+		explicit UGenSchedule( UGen & root );
+		~UGenSchedule();
+		
+		// generate numFrames sample frames for every UGen in the schedule,
+		// rebuilding the schedule first if anything has been patched or unpatched.
+		// afterwards, the block of the root can be read with root.getBlockValues().
+		void render( const int numFrames );
+		
+		// how many UGens were in the schedule the last time it was built.
+		inline int size() const { return (int)mOrder.size(); }
+		
+		// use pool to render the inputs of the root in parallel, or NULL to render serially.
+		// returns the pool we were using, after the audio thread has stopped using it,
+		// so that it is safe to delete.
+		RenderThreadPool * setThreadPool( RenderThreadPool * pool );
+		
+		// time every UGen as it generates its block, see UGen::getProfile.
+		// can be called from any thread, takes effect on the next block.
+		inline void setProfiling( const bool profile ) { mProfiling.store( profile ); }
+		inline bool isProfiling() const { return mProfiling.load(); }
+		
+		// called whenever the connections between UGens change,
+		// so that every schedule knows it needs to be rebuilt before the next block.
+		static void invalidate();
+		
+	private:
+		
+		// topologically sort everything reachable from mRoot into mOrder
+		void build();
+		
+		// mark the ugen as being visited and put it on the stack along with its inputs
+		void push( UGen * ugen, const unsigned int visit );
+		
+		// whether anything ticked privately by the UGens in mOrder is also scheduled,
+		// or ticked privately by more than one of them. visit is what build marked mOrder with.
+		bool findPrivateConflicts( const unsigned int visit );
+		
+		// figure out which UGens can be rendered in parallel
+		void partition();
+		
+		// give every UGen in mOrder room for numFrames in the arena
+		void layoutBlocks( const int numFrames );
+		
+		// renders all of the UGens that belong to one input of the root
+		static void renderTask( void * schedule, const int task );
+		
+		struct Visit
+		{
+			UGen * ugen;
+			// range in mPending of the inputs of ugen and the next one to visit
+			size_t begin;
+			size_t next;
+			size_t end;
+		};
+		
+		UGen &						mRoot;
+		std::vector<UGen*>			mOrder;
+		
+		// the inputs of mOrder[i] are mEdges[mEdgeStart[i]] up to mEdges[mEdgeStart[i+1]]
+		std::vector<UGen*>			mEdges;
+		std::vector<size_t>			mEdgeStart;
+		bool						mHasFeedback;
+		// render by ticking mRoot one sample frame at a time, see findPrivateConflicts
+		bool						mTickFrames;
+		// one sample frame of mRoot when we do
+		std::vector<float>			mFrame;
+		
+		// partitioning of mOrder for parallel rendering: 
+		// mShared goes first, then the tasks, and then the root.
+		// the UGens of task i are mTaskUGens[mTaskStart[i]] up to mTaskUGens[mTaskStart[i+1]]
+		std::vector<int>			mOwner;
+		std::vector<UGen*>			mShared;
+		std::vector<UGen*>			mTaskUGens;
+		std::vector<size_t>			mTaskStart;
+		
+		// the block being rendered, for renderTask
+		int							mBlockFrames;
+		unsigned int				mBlockStamp;
+		bool						mBlockProfiling;
+		
+		std::atomic<bool>			mProfiling;
+		
+		std::atomic<RenderThreadPool*> mPool;
+		// the pool render is using right now, so setThreadPool knows when it's safe to return
+		std::atomic<RenderThreadPool*> mPoolInUse;
+		
+		// scratch space used while building so that it doesn't allocate every time
+		std::vector<Visit>			mStack;
+		std::vector<UGen*>			mPending;
+		
+		// the version of the graph that mOrder was built from
+		unsigned int				mVersion;
+		
+		// block storage for everything in mOrder, see layoutBlocks.
+		// mArena is mArenaMemory aligned to a cache line and has room for mArenaCapacity floats.
+		float *						mArenaMemory;
+		float *						mArena;
+		size_t						mArenaCapacity;
+		// the channel pointers handed out to the UGens
+		std::vector<float*>			mArenaChannels;
+		// how many frames each channel has room for, 0 if the arena needs to be laid out again
+		int							mArenaFrames;
+		
+		static std::atomic<unsigned int> sVersion;
+		static std::atomic<unsigned int> sVisitCount;
+		static std::atomic<unsigned int> sBlockCount;
+	};
+}
+
+#endif // UGENSCHEDULE_H
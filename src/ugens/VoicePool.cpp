@@ -0,0 +1,256 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "VoicePool.h"
+#include "AudioOutput.h"
+#include "UGen.h"
+#include "UGenSchedule.h"
+#include "MixKernels.h"
+
+#include <string.h> // for memset
+
+namespace Minim
+{
+	VoicePool::VoicePool( AudioOutput & output, const int maxPendingNotes, const StealPolicy policy )
+	: mOutput( output )
+	, mPolicy( policy )
+	, mBus( *this )
+	, mNotesStarted( 0 )
+	, mNotes( new Note[ maxPendingNotes ] )
+	, mFreeNotes( maxPendingNotes )
+	{
+		for( int i = 0; i < maxPendingNotes; ++i )
+		{
+			mNotes[i].mPool = this;
+			mFreeNotes.push( &mNotes[i] );
+		}
+		
+		mBus.patch( mOutput );
+	}
+	
+	VoicePool::~VoicePool()
+	{
+		mBus.unpatch( mOutput );
+		
+		for( size_t i = 0; i < mVoices.size(); ++i )
+		{
+			delete mVoiceSchedules[i];
+			mVoices[i]->getOutput().unpatch( mBus );
+			delete mVoices[i];
+		}
+		delete [] mNotes;
+	}
+	
+	///////////////////////////////////////////////////
+	void VoicePool::addVoice( Voice * voice )
+	{
+		mVoices.push_back( voice );
+		mVoiceNote.push_back( 0 );
+		mVoiceStarted.push_back( 0 );
+		
+		voice->getOutput().patch( mBus );
+		mVoiceSchedules.push_back( new UGenSchedule( voice->getOutput() ) );
+	}
+	
+	///////////////////////////////////////////////////
+	bool VoicePool::playNote( const float startTime, const float duration, const float frequency, const float amplitude )
+	{
+		Note * note = NULL;
+		if ( !mFreeNotes.pop( note ) )
+		{
+			return false;
+		}
+		
+		note->mVoice	 = -1;
+		note->mFrequency = frequency;
+		note->mAmplitude = amplitude;
+		
+		mOutput.playNote( startTime, duration, *note );
+		return true;
+	}
+	
+	///////////////////////////////////////////////////
+	int VoicePool::allocateVoice()
+	{
+		const int count = (int)mVoices.size();
+		
+		// anything that's finished is free
+		for( int v = 0; v < count; ++v )
+		{
+			if ( mVoiceNote[v] == 0 && !mVoices[v]->isPlaying() )
+			{
+				return v;
+			}
+		}
+		
+		if ( mPolicy == eStealNone )
+		{
+			return -1;
+		}
+		
+		// steal from the voices that are already releasing if there are any, 
+		// so held notes aren't cut off before they have to be.
+		int best = -1;
+		for( int pass = 0; pass < 2 && best < 0; ++pass )
+		{
+			const bool releasedOnly = ( pass == 0 );
+			float bestLevel = 0;
+			for( int v = 0; v < count; ++v )
+			{
+				if ( releasedOnly && mVoiceNote[v] != 0 )
+				{
+					continue;
+				}
+				
+				if ( mPolicy == eStealOldest )
+				{
+					// the difference handles the counter wrapping around
+					if ( best < 0 || (int)( mVoiceStarted[v] - mVoiceStarted[best] ) < 0 )
+					{
+						best = v;
+					}
+				}
+				else
+				{
+					const float level = mVoices[v]->getLevel();
+					if ( best < 0 || level < bestLevel )
+					{
+						best = v;
+						bestLevel = level;
+					}
+				}
+			}
+		}
+		
+		return best;
+	}
+	
+	///////////////////////////////////////////////////
+	void VoicePool::Note::noteOn( float duration )
+	{
+		VoicePool & pool = *mPool;
+		
+		mVoice = pool.allocateVoice();
+		if ( mVoice >= 0 )
+		{
+			// ids start at 1 so that 0 can mean the voice isn't held
+			mId = ++pool.mNotesStarted;
+			if ( mId == 0 )
+			{
+				mId = ++pool.mNotesStarted;
+			}
+			
+			pool.mVoiceNote[mVoice]	   = mId;
+			pool.mVoiceStarted[mVoice] = mId;
+			pool.mVoices[mVoice]->noteOn( duration, mFrequency, mAmplitude );
+		}
+	}
+	
+	///////////////////////////////////////////////////
+	void VoicePool::Note::noteOff()
+	{
+		VoicePool & pool = *mPool;
+		
+		// if our voice was stolen, the note it's playing now isn't ours to turn off
+		if ( mVoice >= 0 && pool.mVoiceNote[mVoice] == mId )
+		{
+			pool.mVoiceNote[mVoice] = 0;
+			pool.mVoices[mVoice]->noteOff();
+		}
+		
+		mVoice = -1;
+		pool.mFreeNotes.push( this );
+	}
+	
+	///////////////////////////////////////////////////
+	void VoicePool::VoiceBus::channelCountChanged()
+	{
+		Summer::channelCountChanged();
+		mFrame.resize( getAudioChannelCount() );
+	}
+	
+	///////////////////////////////////////////////////
+	void VoicePool::VoiceBus::getInputUGens( std::vector<UGen*> & inputs )
+	{
+		// just our volume, our voices aren't rendered by whoever renders us
+		UGen::getInputUGens( inputs );
+	}
+	
+	///////////////////////////////////////////////////
+	void VoicePool::VoiceBus::getPrivateInputUGens( std::vector<UGen*> & inputs )
+	{
+		UGen::getPrivateInputUGens( inputs );
+		
+		for( size_t i = 0; i < mPool.mVoices.size(); ++i )
+		{
+			inputs.push_back( &mPool.mVoices[i]->getOutput() );
+		}
+	}
+	
+	///////////////////////////////////////////////////
+	void VoicePool::VoiceBus::uGenerate( float * channels, const int numChannels )
+	{
+		UGen::fill( channels, 0, numChannels );
+		
+		float * frame = &mFrame[0];
+		const float v = volume.getLastValue();
+		for( size_t i = 0; i < mPool.mVoices.size(); ++i )
+		{
+			if ( mPool.mVoices[i]->isPlaying() )
+			{
+				mPool.mVoices[i]->getOutput().tick( frame, numChannels );
+				UGen::accum( channels, frame, numChannels, v );
+			}
+		}
+	}
+	
+	///////////////////////////////////////////////////
+	void VoicePool::VoiceBus::uGenerateBlock( float ** channels, const int numChannels, const int numFrames )
+	{
+		for( int c = 0; c < numChannels; ++c )
+		{
+			memset( channels[c], 0, sizeof(float)*numFrames );
+		}
+		
+		float * const * volumeBlock = volume.getBlockValues();
+		const float * v = volumeBlock ? volumeBlock[0] : NULL;
+		const float   vol = volume.getLastValue();
+		for( size_t i = 0; i < mPool.mVoices.size(); ++i )
+		{
+			if ( !mPool.mVoices[i]->isPlaying() )
+			{
+				continue;
+			}
+			
+			mPool.mVoiceSchedules[i]->render( numFrames );
+			
+			float * const * voice = mPool.mVoices[i]->getOutput().getBlockValues();
+			for( int c = 0; c < numChannels; ++c )
+			{
+				if ( v )
+				{
+					MixKernels::accum( channels[c], voice[c], v, numFrames );
+				}
+				else
+				{
+					MixKernels::accum( channels[c], voice[c], vol, numFrames );
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,203 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef VOICEPOOL_H
+#define VOICEPOOL_H
+
+#include "Instrument.h"
+#include "LockFreeQueue.h"
+#include "Summer.h"
+
+#include <vector>
+
+namespace Minim
+{
+	class AudioOutput;
+	class UGen;
+	class UGenSchedule;
+	
+	/**
+	 * One voice of a VoicePool. Unlike an Instrument, a Voice is made once and played 
+	 * over and over, so it is given what to play every time it gets a note. Typically it 
+	 * will be a chain of UGens that ends in an ADSR, which the pool patches to the output 
+	 * once, when the voice is added, and only renders while isPlaying is true:
+	 *
+	 * <pre>
+	 * class SineVoice : public Voice
+	 * {
+	 * public:
+	 *     SineVoice() : osc( 440, 1, Waves::SINE() ), env( 0.5f, 0.01f, 0.05f, 0.5f, 0.3f ) { osc.patch( env ); }
+	 *
+	 *     virtual UGen & getOutput() { return env; }
+	 *     virtual void noteOn( float duration, float frequency, float amplitude ) 
+	 *     { 
+	 *         osc.frequency.setLastValue( frequency ); 
+	 *         osc.amplitude.setLastValue( amplitude ); 
+	 *         env.noteOn(); 
+	 *     }
+	 *     virtual void noteOff() { env.noteOff(); }
+	 *     virtual bool isPlaying() const { return env.isPlaying(); }
+	 *     virtual float getLevel() const { return env.getAmplitude(); }
+	 *
+	 * private:
+	 *     Oscil osc;
+	 *     ADSR  env;
+	 * };
+	 * </pre>
+	 */
+	class Voice
+	{
+	public:
+		virtual ~Voice() {}
+		
+		// the end of this voice's UGen chain, the pool patches it to the output.
+		virtual UGen & getOutput() = 0;
+		
+		// start playing a note, which might mean cutting off the one we were playing if we were stolen.
+		virtual void noteOn( float duration, float frequency, float amplitude ) = 0;
+		
+		// begin the release of the note we're playing.
+		virtual void noteOff() = 0;
+		
+		// whether we are still making sound, including our release.
+		// the pool only gives a new note to a voice that is still playing if it has to steal one,
+		// and doesn't render a voice that isn't playing, so nothing it is made of advances while idle.
+		virtual bool isPlaying() const = 0;
+		
+		// how loud we are right now, used to find the quietest voice to steal.
+		virtual float getLevel() const { return 0; }
+	};
+	
+	/**
+	 * A fixed set of Voices that notes are played on, so that a dense score doesn't allocate 
+	 * an Instrument and patch it to the output for every note. All of the voices are made and 
+	 * patched to the output up front and stay patched, but a voice that isn't playing 
+	 * isn't rendered at all, so idle voices cost next to nothing.
+	 * When a note starts it gets a voice that isn't playing, or steals one if they all are.
+	 *
+	 * playNote schedules the note on the output's NoteManager just like AudioOutput::playNote,
+	 * and voices are picked on the audio thread when the note actually starts. A note whose voice 
+	 * was stolen before it ended doesn't turn off the note that stole it.
+	 *
+	 * Add all the voices before playing any notes. Destroy the pool before the output,
+	 * once everything it scheduled has been played, or after the output has been closed.
+	 */
+	class VoicePool
+	{
+	public:
+		enum StealPolicy
+		{
+			// drop a note if every voice is playing
+			eStealNone,
+			// take the voice that has been playing the longest
+			eStealOldest,
+			// take the voice with the lowest level
+			eStealQuietest
+		};
+		
+		// maxPendingNotes is how many notes can be scheduled but not finished at once.
+		VoicePool( AudioOutput & output, const int maxPendingNotes = 256, const StealPolicy policy = eStealOldest );
+		~VoicePool();
+		
+		// we own voice from now on, and patch it to our output.
+		void addVoice( Voice * voice );
+		
+		// make count voices of type T with its default constructor
+		template<typename T>
+		void addVoices( const int count )
+		{
+			for( int i = 0; i < count; ++i )
+			{
+				addVoice( new T() );
+			}
+		}
+		
+		inline int getVoiceCount() const { return (int)mVoices.size(); }
+		
+		inline void		   setStealPolicy( const StealPolicy policy ) { mPolicy = policy; }
+		inline StealPolicy getStealPolicy() const { return mPolicy; }
+		
+		// play a note on one of our voices, startTime and duration are in beats, as in AudioOutput::playNote.
+		// returns false if maxPendingNotes are already scheduled.
+		bool playNote( const float startTime, const float duration, const float frequency, const float amplitude );
+		
+	private:
+		
+		// what actually goes to the NoteManager, one per scheduled note. 
+		// they are made up front and recycled once their note has ended.
+		class Note : public Instrument
+		{
+		public:
+			Note() : mPool(NULL), mVoice(-1), mId(0), mFrequency(0), mAmplitude(0) {}
+			
+			virtual void noteOn( float duration );
+			virtual void noteOff();
+			
+			VoicePool *		mPool;
+			// which voice we got and the id we had when we got it
+			int				mVoice;
+			unsigned int	mId;
+			float			mFrequency;
+			float			mAmplitude;
+		};
+		friend class Note;
+		
+		// what our voices are patched to, it renders the ones that are playing and sums them.
+		// each voice is rendered by a schedule of its own, so the output's schedule leaves them out.
+		class VoiceBus : public Summer
+		{
+		public:
+			explicit VoiceBus( VoicePool & pool ) : mPool(pool), mFrame(1) {}
+			
+			virtual void uGenerate( float * channels, const int numChannels );
+			virtual void uGenerateBlock( float ** channels, const int numChannels, const int numFrames );
+			
+		protected:
+			virtual void channelCountChanged();
+			virtual void getInputUGens( std::vector<UGen*> & inputs );
+			virtual void getPrivateInputUGens( std::vector<UGen*> & inputs );
+			
+		private:
+			VoicePool & mPool;
+			// one sample frame of a voice, for uGenerate
+			std::vector<float> mFrame;
+		};
+		friend class VoiceBus;
+		
+		// the voice to play a new note on, or -1 if there isn't one we can have
+		int allocateVoice();
+		
+		AudioOutput &			mOutput;
+		StealPolicy				mPolicy;
+		
+		VoiceBus				mBus;
+		std::vector<Voice*>		mVoices;
+		// renders the UGens of each voice into the block of its output
+		std::vector<UGenSchedule*> mVoiceSchedules;
+		// the id of the note each voice is holding, 0 once it has been turned off
+		std::vector<unsigned int> mVoiceNote;
+		// when each voice started its current note, in notes started
+		std::vector<unsigned int> mVoiceStarted;
+		unsigned int			mNotesStarted;
+		
+		Note *					mNotes;
+		LockFreeQueue<Note*>	mFreeNotes;
+	};
+}
+
+#endif // VOICEPOOL_H
@@ -19,14 +19,42 @@
 #ifndef WAVEFORM_H
 #define WAVEFORM_H
 
+#include <atomic>
+#include <stddef.h> // for NULL
+
 namespace Minim 
 {
+	class Wavetable;
 	
+	// Waveforms are reference counted so that many UGens can share one, see Waves::shared.
+	// Whoever makes one holds the first reference, and handing it to an Oscil, WaveShaper, 
+	// or the like hands that reference over, which is why they seem to delete what they're given.
 	class Waveform
 	{
 	public:
+		Waveform() : mRefCount(1) {}
 		virtual ~Waveform() {}
+		
+		inline void retain() const { ++mRefCount; }
+		// deletes us when there are no references left
+		inline void release() const 
+		{ 
+			if ( --mRefCount == 0 ) 
+			{
+				delete this;
+			}
+		}
 		virtual float value( const float at ) const = 0;
+		
+		// the value at `at` when it is being stepped through step cycles per sample,
+		// which waveforms that can avoid aliasing use to decide what to leave out.
+		virtual float value( const float at, const float /*step*/ ) const { return value( at ); }
+		
+		// waveforms that are nothing but a Wavetable return it, so Oscil can read the table directly.
+		virtual const Wavetable * asWavetable() const { return NULL; }
+		
+	private:
+		mutable std::atomic<int> mRefCount;
 	};
 	
 };
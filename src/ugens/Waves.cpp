@@ -18,6 +18,10 @@
 
 #include "Waves.h"
 #include "Logging.h"
+#include "FFT.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
 #include <vector>
 
 #define  _USE_MATH_DEFINES // required in windows to get constants like M_PI
@@ -116,6 +120,42 @@ namespace Minim
 			return result;
 		}
 
+		BandLimitedWavetable * sawbl( int tableSize )
+		{
+			// BandLimitedWavetable won't use more than this
+			const int numberOfHarmonics = (tableSize - 1) / 4;
+			std::vector<float> content( numberOfHarmonics > 0 ? numberOfHarmonics : 1, 0.f );
+			for (int i = 0; i < numberOfHarmonics; ++i)
+			{
+				// SAW falls from the middle, so this is upside down from sawh
+				content[i] = (float)(2 / ((i + 1) * M_PI) * pow(-1, i + 1));
+			}
+			return new BandLimitedWavetable( &content[0], numberOfHarmonics, tableSize );
+		}
+		
+		BandLimitedWavetable * squarebl( int tableSize )
+		{
+			const int numberOfHarmonics = (tableSize - 1) / 4;
+			std::vector<float> content( numberOfHarmonics > 0 ? numberOfHarmonics : 1, 0.f );
+			for (int i = 0; i < numberOfHarmonics; i += 2)
+			{
+				// SQUARE starts low, so this is upside down from squareh
+				content[i] = (float)(-4 / ((i + 1) * M_PI));
+			}
+			return new BandLimitedWavetable( &content[0], numberOfHarmonics, tableSize );
+		}
+		
+		BandLimitedWavetable * trianglebl( int tableSize )
+		{
+			const int numberOfHarmonics = (tableSize - 1) / 4;
+			std::vector<float> content( numberOfHarmonics > 0 ? numberOfHarmonics : 1, 0.f );
+			for (int i = 0; i < numberOfHarmonics; i += 2)
+			{
+				content[i] = (float)(pow(-1, i / 2) * 8 / M_PI / M_PI / pow(i + 1, 2));
+			}
+			return new BandLimitedWavetable( &content[0], numberOfHarmonics, tableSize );
+		}
+
 		Wavetable* randomNHarms(int numberOfHarms, int tableSize)
         {            
             float* harmAmps = new float[numberOfHarms];
@@ -173,6 +213,118 @@ namespace Minim
 			return table;
 		}
 		
+		// with fewer harmonics than this it's quicker to sum them up than to do the FFTs
+		static const int kHarmonicsForFFT = 32;
+		
+		// the sample rate doesn't matter to the FFTs we use for building tables
+		static const float kFFTSampleRate = 44100.f;
+		
+		// add amp * sin( 2 * PI * partial * i / period + phase ) to the spectrum of a table period samples long.
+		// half of it goes in the bin for partial and half in the bin for -partial.
+		static void addPartial( std::vector<double> & real, std::vector<double> & imag, const long long partial, const double amp, const double phase )
+		{
+			const long long period = (long long)real.size();
+			const int positive = (int)( ( partial % period + period ) % period );
+			const int negative = (int)( ( -partial % period + period ) % period );
+			real[positive] += 0.5 * amp * sin( phase );
+			imag[positive] -= 0.5 * amp * cos( phase );
+			real[negative] += 0.5 * amp * sin( phase );
+			imag[negative] += 0.5 * amp * cos( phase );
+		}
+		
+		// adds the inverse DFT of the spectrum to the first period samples of waveform.
+		// a period that is a power of two is one inverse FFT, any other is done as a
+		// convolution with FFTs twice as long (Bluestein's algorithm).
+		static void addInverse( float * waveform, const std::vector<double> & real, const std::vector<double> & imag )
+		{
+			const int period = (int)real.size();
+			
+			if ( ( period & (period - 1) ) == 0 )
+			{
+				FFT fft( period, kFFTSampleRate );
+				float * specReal = fft.getSpectrumReal();
+				float * specImag = fft.getSpectrumImaginary();
+				// inverse scales by 1/period, which we don't want
+				for ( int k = 0; k < period; ++k )
+				{
+					specReal[k] = (float)( real[k] * period );
+					specImag[k] = (float)( imag[k] * period );
+				}
+				
+				std::vector<float> samples( period );
+				fft.inverse( &samples[0] );
+				for ( int n = 0; n < period; ++n )
+				{
+					waveform[n] += samples[n];
+				}
+				return;
+			}
+			
+			int fftSize = 1;
+			while ( fftSize < 2 * period - 1 )
+			{
+				fftSize <<= 1;
+			}
+			
+			// k*n = ( k*k + n*n - (k-n)*(k-n) ) / 2, so the inverse DFT is the spectrum times
+			// the chirp exp( i*PI*k*k/period ), convolved with the conjugate chirp, times the chirp again.
+			std::vector<double> chirpReal( period ), chirpImag( period );
+			for ( int n = 0; n < period; ++n )
+			{
+				// n*n gets big, so wrap it around first to keep the angle accurate
+				const long long wrapped = ( (long long)n * n ) % ( 2LL * period );
+				const double angle = M_PI * wrapped / period;
+				chirpReal[n] = cos( angle );
+				chirpImag[n] = sin( angle );
+			}
+			
+			FFT fft( fftSize, kFFTSampleRate );
+			std::vector<float> bufferReal( fftSize, 0.f ), bufferImag( fftSize, 0.f );
+			
+			// the conjugate chirp, for offsets from -(period-1) to period-1
+			for ( int n = 0; n < period; ++n )
+			{
+				bufferReal[n] = (float)chirpReal[n];
+				bufferImag[n] = (float)-chirpImag[n];
+				if ( n > 0 )
+				{
+					bufferReal[fftSize - n] = bufferReal[n];
+					bufferImag[fftSize - n] = bufferImag[n];
+				}
+			}
+			fft.forward( &bufferReal[0], &bufferImag[0] );
+			std::vector<float> chirpSpectrumReal( fft.getSpectrumReal(), fft.getSpectrumReal() + fftSize );
+			std::vector<float> chirpSpectrumImag( fft.getSpectrumImaginary(), fft.getSpectrumImaginary() + fftSize );
+			
+			// the spectrum times the chirp
+			std::fill( bufferReal.begin(), bufferReal.end(), 0.f );
+			std::fill( bufferImag.begin(), bufferImag.end(), 0.f );
+			for ( int k = 0; k < period; ++k )
+			{
+				bufferReal[k] = (float)( real[k] * chirpReal[k] - imag[k] * chirpImag[k] );
+				bufferImag[k] = (float)( real[k] * chirpImag[k] + imag[k] * chirpReal[k] );
+			}
+			fft.forward( &bufferReal[0], &bufferImag[0] );
+			
+			// multiply the two and conjugate, so another forward FFT does the inverse
+			const float * specReal = fft.getSpectrumReal();
+			const float * specImag = fft.getSpectrumImaginary();
+			for ( int k = 0; k < fftSize; ++k )
+			{
+				bufferReal[k] = specReal[k] * chirpSpectrumReal[k] - specImag[k] * chirpSpectrumImag[k];
+				bufferImag[k] = -( specReal[k] * chirpSpectrumImag[k] + specImag[k] * chirpSpectrumReal[k] );
+			}
+			fft.forward( &bufferReal[0], &bufferImag[0] );
+			
+			// conjugate back, scale, and take the real part of that times the chirp
+			for ( int n = 0; n < period; ++n )
+			{
+				const double convReal = specReal[n] / fftSize;
+				const double convImag = -specImag[n] / fftSize;
+				waveform[n] += (float)( chirpReal[n] * convReal - chirpImag[n] * convImag );
+			}
+		}
+		
 		Wavetable * gen9( int size, 
 						  float * partials, int nPartials, 
 						  float * amps, int nAmps, 
@@ -190,24 +342,201 @@ namespace Minim
 			Wavetable * table = new Wavetable( size );
 			float * waveform = table->getWaveform();
 			
+			// whole number partials can go in a spectrum, the rest we sum up
+			std::vector<char> inSpectrum( nPartials, 0 );
+			int spectrumCount = 0;
+			for (int j = 0; j < nPartials; j++)
+			{
+				inSpectrum[j] = partials[j] == floorf( partials[j] ) && fabsf( partials[j] ) < 1e9f;
+				spectrumCount += inSpectrum[j];
+			}
+			
+			if ( spectrumCount < kHarmonicsForFFT || size < 3 )
+			{
+				std::fill( inSpectrum.begin(), inSpectrum.end(), 0 );
+			}
+			else
+			{
+				std::vector<double> real( size - 1, 0.0 ), imag( size - 1, 0.0 );
+				for (int j = 0; j < nPartials; j++)
+				{
+					if ( inSpectrum[j] )
+					{
+						addPartial( real, imag, (long long)partials[j], amps[j], phases[j] );
+					}
+				}
+				addInverse( waveform, real, imag );
+				waveform[size - 1] = waveform[0];
+			}
+			
 			float index = 0;
 			for (int i = 0; i < size; i++)
 			{
 				index = (float)i / (size - 1);
 				for (int j = 0; j < nPartials; j++)
 				{
-					waveform[i] += amps[j] * (float)sin(2 * M_PI * partials[j] * index + phases[j]);
+					if ( !inSpectrum[j] )
+					{
+						waveform[i] += amps[j] * (float)sin(2 * M_PI * partials[j] * index + phases[j]);
+					}
 				}
 			}
 			
 			return table;
 		}
 		
+		// what shared waveforms are looked up by
+		struct SharedKey
+		{
+			int  shape;
+			int  tableSize;
+			int  numberOfHarmonics;
+			bool bandLimited;
+			
+			bool operator<( const SharedKey & other ) const
+			{
+				if ( shape != other.shape ) return shape < other.shape;
+				if ( tableSize != other.tableSize ) return tableSize < other.tableSize;
+				if ( numberOfHarmonics != other.numberOfHarmonics ) return numberOfHarmonics < other.numberOfHarmonics;
+				return bandLimited < other.bandLimited;
+			}
+		};
+		
+		// holds a reference to every shared waveform, which it lets go of when the program exits
+		// or releaseShared is called. made the first time it's needed so it works during static init.
+		struct SharedWaveforms
+		{
+			typedef std::map<SharedKey, const Waveform*> Map;
+			
+			std::mutex mutex;
+			Map		   waveforms;
+			
+			~SharedWaveforms()
+			{
+				release();
+			}
+			
+			void release()
+			{
+				for( Map::iterator it = waveforms.begin(); it != waveforms.end(); ++it )
+				{
+					it->second->release();
+				}
+				waveforms.clear();
+			}
+			
+			static SharedWaveforms & get()
+			{
+				static SharedWaveforms s_shared;
+				return s_shared;
+			}
+		};
+		
+		static Wavetable * makeShared( Shape shape, int tableSize, int numberOfHarmonics )
+		{
+			switch( shape )
+			{
+				case ePhasor:			 return PHASOR( tableSize );
+				case eSine:				 return SINE( tableSize );
+				case eSaw:				 return SAW( tableSize );
+				case eSquare:			 return SQUARE( tableSize );
+				case eTriangle:			 return TRIANGLE( tableSize );
+				case eQuarterPulse:		 return QUARTERPULSE( tableSize );
+				case eSawHarmonics:		 return sawh( numberOfHarmonics, tableSize );
+				case eSquareHarmonics:	 return squareh( numberOfHarmonics, tableSize );
+				case eTriangleHarmonics: return triangleh( numberOfHarmonics, tableSize );
+			}
+			return NULL;
+		}
+		
+		static BandLimitedWavetable * makeSharedbl( Shape shape, int tableSize )
+		{
+			switch( shape )
+			{
+				case eSine:
+				{
+					float amp[] = { 1.f };
+					return new BandLimitedWavetable( amp, 1, tableSize );
+				}
+				case eSaw:		return sawbl( tableSize );
+				case eSquare:	return squarebl( tableSize );
+				case eTriangle: return trianglebl( tableSize );
+				default:		break;
+			}
+			Minim::error("Only sine, saw, square, and triangle can be band limited!");
+			return NULL;
+		}
+		
+		const Wavetable * shared( Shape shape, int tableSize, int numberOfHarmonics )
+		{
+			const bool usesHarmonics = shape == eSawHarmonics || shape == eSquareHarmonics || shape == eTriangleHarmonics;
+			SharedKey key = { shape, tableSize, usesHarmonics ? numberOfHarmonics : 0, false };
+			
+			SharedWaveforms & shared = SharedWaveforms::get();
+			std::lock_guard<std::mutex> lock( shared.mutex );
+			
+			SharedWaveforms::Map::iterator it = shared.waveforms.find( key );
+			if ( it == shared.waveforms.end() )
+			{
+				const Wavetable * table = makeShared( shape, tableSize, key.numberOfHarmonics );
+				if ( !table )
+				{
+					return NULL;
+				}
+				it = shared.waveforms.insert( SharedWaveforms::Map::value_type( key, table ) ).first;
+			}
+			
+			// one for the caller, we keep the one it was made with
+			it->second->retain();
+			return static_cast<const Wavetable*>( it->second );
+		}
+		
+		const BandLimitedWavetable * sharedbl( Shape shape, int tableSize )
+		{
+			SharedKey key = { shape, tableSize, 0, true };
+			
+			SharedWaveforms & shared = SharedWaveforms::get();
+			std::lock_guard<std::mutex> lock( shared.mutex );
+			
+			SharedWaveforms::Map::iterator it = shared.waveforms.find( key );
+			if ( it == shared.waveforms.end() )
+			{
+				const BandLimitedWavetable * table = makeSharedbl( shape, tableSize );
+				if ( !table )
+				{
+					return NULL;
+				}
+				it = shared.waveforms.insert( SharedWaveforms::Map::value_type( key, table ) ).first;
+			}
+			
+			it->second->retain();
+			return static_cast<const BandLimitedWavetable*>( it->second );
+		}
+		
+		void releaseShared()
+		{
+			SharedWaveforms & shared = SharedWaveforms::get();
+			std::lock_guard<std::mutex> lock( shared.mutex );
+			shared.release();
+		}
+		
 		Wavetable * gen10( int size, float * amps, int nAmps )
 		{
 			Wavetable * table = new Wavetable(size);
 			float * waveform = table->getWaveform();
 			
+			if ( nAmps >= kHarmonicsForFFT && size > 2 )
+			{
+				std::vector<double> real( size - 1, 0.0 ), imag( size - 1, 0.0 );
+				for (int j = 0; j < nAmps; j++)
+				{
+					addPartial( real, imag, j + 1, amps[j], 0 );
+				}
+				addInverse( waveform, real, imag );
+				waveform[size - 1] = waveform[0];
+				return table;
+			}
+			
 			float index = 0;
 			for (int i = 0; i < size; i++)
 			{
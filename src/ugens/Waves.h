@@ -20,6 +20,7 @@
 #define WAVES_H
 
 #include "Wavetable.h"
+#include "BandLimitedWavetable.h"
 
 namespace Minim  
 {
@@ -40,6 +41,12 @@ namespace Minim
 		Wavetable * sawh     ( int numberOfHarmonics, int tableSize = kDefaultTableSize );
 		Wavetable * squareh  ( int numberOfHarmonics, int tableSize = kDefaultTableSize );
 		Wavetable * triangleh( int numberOfHarmonics, int tableSize = kDefaultTableSize );
+		
+		// the same shapes as SAW, SQUARE, and TRIANGLE that don't alias at high frequencies,
+		// with as many harmonics as tableSize allows. see BandLimitedWavetable.
+		BandLimitedWavetable * sawbl     ( int tableSize = kDefaultTableSize );
+		BandLimitedWavetable * squarebl  ( int tableSize = kDefaultTableSize );
+		BandLimitedWavetable * trianglebl( int tableSize = kDefaultTableSize );
         
 		// #TODO duty cycle versions of basic waves
 		Wavetable *	pulse   ( float dutyCycle, int tableSize = kDefaultTableSize );
@@ -59,6 +66,37 @@ namespace Minim
 						  float * phases, int nPhases 
 						 );
 		Wavetable * gen10( int size, float * amps, int nAmps );
+		
+		// the shapes that can be shared
+		enum Shape
+		{
+			ePhasor,
+			eSine,
+			eSaw,
+			eSquare,
+			eTriangle,
+			eQuarterPulse,
+			// these are built with numberOfHarmonics, like sawh, squareh, and triangleh
+			eSawHarmonics,
+			eSquareHarmonics,
+			eTriangleHarmonics
+		};
+		
+		// A wavetable of shape that is shared with everything else that asks for the same shape, size,
+		// and number of harmonics. It is made the first time it is asked for and the same one is handed
+		// out after that, so a thousand sine Oscils use one table and only compute it once.
+		// It must not be changed. You get a reference to it, so pass it to an Oscil or WaveShaper
+		// just like a new one, or call release when you are done with it.
+		// Safe to call from any thread except the audio thread, since it might have to build the table.
+		const Wavetable * shared( Shape shape, int tableSize = kDefaultTableSize, int numberOfHarmonics = 0 );
+		
+		// The same for sawbl, squarebl, and trianglebl, with eSaw, eSquare, and eTriangle.
+		// eSine gives a table with just the fundamental. Anything else is an error and returns NULL.
+		const BandLimitedWavetable * sharedbl( Shape shape, int tableSize = kDefaultTableSize );
+		
+		// Let go of every shared waveform, each is deleted once nothing else is using it.
+		// Anything asked for after this is made again.
+		void releaseShared();
 	}
 }
 
@@ -25,7 +25,7 @@
 
 namespace Minim 
 {
-	WaveShaper::WaveShaper( const float outAmp, const float mapAmp, Wavetable * mapShape, const bool bWrapMap )
+	WaveShaper::WaveShaper( const float outAmp, const float mapAmp, const Wavetable * mapShape, const bool bWrapMap )
 	: UGen()
 	, audio( *this, AUDIO )
 	, outAmplitude( *this, CONTROL )
@@ -40,7 +40,10 @@ namespace Minim
 	
 	WaveShaper::~WaveShaper()
 	{
-		delete m_pMapShape;
+		if ( m_pMapShape )
+		{
+			m_pMapShape->release();
+		}
 	}
 	
 	float WaveShaper::getMapLookup( const float in )
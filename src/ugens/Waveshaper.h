@@ -31,8 +31,8 @@ namespace Minim
 	class WaveShaper : public UGen
 	{
 	public:
-		// will delete mapShape on deconstruction
-		WaveShaper( const float outAmp, const float mapAmp, Wavetable * mapShape, const bool bWrapMap = false );
+		// will release mapShape on deconstruction
+		WaveShaper( const float outAmp, const float mapAmp, const Wavetable * mapShape, const bool bWrapMap = false );
 		virtual ~WaveShaper();
 		
 		/**
@@ -50,7 +50,8 @@ namespace Minim
 		 */
 		UGenInput mapAmplitude;
 		
-		Wavetable & getWavetable() { return *m_pMapShape; }
+		// it might be shared, so it can't be changed
+		const Wavetable & getWavetable() const { return *m_pMapShape; }
         
         float getLastMapValue() const { return m_lastMapLookup; }
 		
@@ -64,7 +65,7 @@ namespace Minim
         float getMapLookup( const float in );
 		
 		// the wavetable we use to shape our input
-		Wavetable * m_pMapShape;
+		const Wavetable * m_pMapShape;
 		// whether or not to wrap around or clamp at the edges of the map shape.
 		bool		m_bWrapMap;
         // the last map lookup value we generated
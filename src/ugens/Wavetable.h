@@ -45,6 +45,9 @@ namespace Minim
 		
 		// Waveform impl: at should be between 0 and 1.
 		virtual float value( const float at ) const;
+		virtual float value( const float at, const float /*step*/ ) const { return Wavetable::value( at ); }
+		// subclasses that override value should return NULL from this
+		virtual const Wavetable * asWavetable() const { return this; }
 		
 		inline float * getWaveform() { return mWaveform; }
 		inline const float * getWaveform() const { return mWaveform; }
@@ -57,6 +60,8 @@ namespace Minim
 		void rectify();
 		// void smooth( int windowLength );
 		
+		// when true, value returns the sample before at without interpolating, for every Wavetable.
+		// Oscils that want that should be constructed with Oscil::eNone instead.
 		static bool s_opt;
 		
 	private:
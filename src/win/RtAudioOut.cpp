@@ -1,6 +1,7 @@
 #include "RtAudioOut.h"
 #include "AudioStream.h"
 #include "AudioListener.h"
+#include "MixKernels.h"
 
 
 RtAudioOut::RtAudioOut( const Minim::AudioFormat & outputFormat, int outputBufferSize )
@@ -11,7 +12,12 @@ RtAudioOut::RtAudioOut( const Minim::AudioFormat & outputFormat, int outputBuffe
 	, m_listener( 0 )
 	, m_out()
 	, m_description( "RtAudioOut: " )
+	, m_threadSetup( 0 )
+	, m_threadSetupData( 0 )
+	, m_bThreadSetUp( false )
+	, m_threadReportState( eThreadReportEmpty )
 {
+	m_threadReport[0] = 0;
 }
 
 
@@ -31,6 +37,31 @@ void RtAudioOut::setAudioListener( Minim::AudioListener* listener )
 	m_listener = listener;
 }
 
+const char * RtAudioOut::getDescription() const
+{
+	// the thread setup happens on the audio thread, which can't append to the description itself
+	int ready = eThreadReportReady;
+	if ( m_threadReportState.compare_exchange_strong( ready, eThreadReportReading ) )
+	{
+		if ( m_threadReport[0] )
+		{
+			m_description += ", ";
+			m_description += m_threadReport;
+		}
+		m_threadReportState.store( eThreadReportEmpty );
+	}
+
+	return m_description.c_str();
+}
+
+void RtAudioOut::setThreadSetup( ThreadSetupFunction func, void * userData )
+{
+	BMutexLock lock( m_mutex );
+	m_threadSetup	  = func;
+	m_threadSetupData = userData;
+	m_bThreadSetUp	  = false;
+}
+
 void RtAudioOut::open(void)
 {
 	if ( m_out.isStreamOpen() ) return;
@@ -65,6 +96,7 @@ void RtAudioOut::open(void)
 		m_bufferSize = bufferFrames;
 		try
 		{
+			m_bThreadSetUp = false;
 			m_out.startStream();
 
 			RtAudio::DeviceInfo info = m_out.getDeviceInfo(parameters.deviceId);
@@ -125,6 +157,7 @@ void RtAudioOut::resumeProcessing()
 
 	try
 	{
+		m_bThreadSetUp = false;
 		m_out.startStream();
 	}
 	catch( RtError& e )
@@ -140,6 +173,23 @@ int RtAudioOut::renderCallback( void *outputBuffer, void *inputBuffer, unsigned
 
 	BMutexLock lock( out->m_mutex );
 
+	if ( out->m_threadSetup && !out->m_bThreadSetUp )
+	{
+		char report[kThreadReportSize];
+		report[0] = 0;
+		out->m_threadSetup( out->m_threadSetupData, report, kThreadReportSize );
+		report[kThreadReportSize-1] = 0;
+
+		// publish it for getDescription. if the last one hasn't been picked up yet, 
+		// it says the same thing, since this thread was set up the same way.
+		if ( out->m_threadReportState.load() == eThreadReportEmpty )
+		{
+			strcpy( out->m_threadReport, report );
+			out->m_threadReportState.store( eThreadReportReady );
+		}
+		out->m_bThreadSetUp = true;
+	}
+
 	out->m_buffer.setBufferSize( nBufferFrames );
 	out->m_bufferSize = nBufferFrames;
 
@@ -147,13 +197,7 @@ int RtAudioOut::renderCallback( void *outputBuffer, void *inputBuffer, unsigned
 	{
 		const int channels = out->m_format.getChannels();
 		out->m_stream->read( out->m_buffer );
-		for( unsigned int i = 0; i < nBufferFrames; ++i )
-		{
-			for( int c = 0; c < channels; ++c )
-			{
-				buffer[i*channels + c] = out->m_buffer.getSample(c,(int)i);
-			}
-		}
+		Minim::MixKernels::interleave( buffer, out->m_buffer.getChannels(), channels, (int)nBufferFrames );
 	}
 	else 
 	{
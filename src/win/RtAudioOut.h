@@ -4,9 +4,14 @@
 #include "RtAudio.h"
 #include "BMutex.hpp"
 #include <string.h>
+#include <string>
+#include <atomic>
 
-class Minim::AudioStream;
-class Minim::AudioListener;
+namespace Minim
+{
+	class AudioStream;
+	class AudioListener;
+}
 
 class RtAudioOut : public Minim::AudioOut
 {
@@ -15,7 +20,7 @@ public:
 	virtual ~RtAudioOut(void);
 
 	// AudioOut implementation
-	virtual const int bufferSize() const { return m_bufferSize; }
+	virtual int bufferSize() const { return m_bufferSize; }
 	virtual void setAudioStream( Minim::AudioStream * stream );
     virtual void setAudioListener( Minim::AudioListener * listen );
 	virtual const Minim::MultiChannelBuffer & getOutputBuffer() const { return m_buffer; }
@@ -26,7 +31,14 @@ public:
 	virtual void open();
 	virtual void close();
 	virtual const Minim::AudioFormat & getFormat() const { return m_format; }
-	virtual const char * getDescription() const { return m_description.c_str(); }
+	virtual const char * getDescription() const;
+
+	// Called on the audio thread before it renders its first buffer, which lets a ServiceProvider 
+	// configure the thread RtAudio created for us (priority, affinity, floating point modes). 
+	// Whatever the function writes to report, which holds reportSize chars and starts out empty, 
+	// is added to our description the next time it is asked for. It mustn't allocate.
+	typedef void (*ThreadSetupFunction)( void * userData, char * report, const size_t reportSize );
+	void setThreadSetup( ThreadSetupFunction func, void * userData );
 
 private:
 
@@ -41,6 +53,16 @@ private:
 	Minim::AudioListener*		m_listener;
 	RtAudio						m_out;
 	// description of the audio device we wind up using
-	std::string					m_description;
+	mutable std::string			m_description;
+	ThreadSetupFunction			m_threadSetup;
+	void*						m_threadSetupData;
+	// starting the stream can create a new thread, so this is cleared every time we start
+	bool						m_bThreadSetUp;
+	// what the thread setup reported. the audio thread only writes it when it is eThreadReportEmpty,
+	// getDescription adds it to m_description when it is eThreadReportReady.
+	enum { eThreadReportEmpty, eThreadReportReady, eThreadReportReading };
+	static const size_t			kThreadReportSize = 256;
+	char						m_threadReport[kThreadReportSize];
+	mutable std::atomic<int>	m_threadReportState;
 };
 
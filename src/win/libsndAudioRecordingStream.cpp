@@ -19,6 +19,7 @@
 #include "libsndAudioRecordingStream.h"
 #include "Logging.h"
 #include <sstream>
+#include <string.h> // for memset
 
 libsndAudioRecordingStream::libsndAudioRecordingStream( const char * filePath, const int bufferSize )
 : m_metaData( this )
@@ -18,6 +18,8 @@
 
 #include "mpg123AudioRecordingStream.h"
 #include "Logging.h"
+#include <stdio.h> // for sprintf
+#include <string.h> // for memset
 
 mpg123AudioRecordingStream::mpg123AudioRecordingStream( const char * filePath, const int bufferSize )
 : m_metaData( this )
@@ -204,7 +206,7 @@ void mpg123AudioRecordingStream::read( Minim::MultiChannelBuffer & buffer )
 				else if ( err != MPG123_OK )
 				{
 					char msg[128];
-					sprintf_s( msg, "Error reading from mp3 file: %s\n", mpg123_plain_strerror(err) );
+					sprintf( msg, "Error reading from mp3 file: %s\n", mpg123_plain_strerror(err) );
 					Minim::error( msg );
 					return;
 				}
@@ -0,0 +1,258 @@
+/*
+ *   Author: Damien Di Fede <ddf@compartmental.net>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as published
+ *   by the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Library General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/////////////////////////////////////////////////////////////////////
+// UGenScheduleTest
+//
+// Renders graphs with UGens that tick what is patched to them privately
+// (Pan, TickRate and inputs with a control rate) with render threads and
+// without, and checks that every sample is the same. Each graph is rendered
+// with block sizes that change from one block to the next, which is what
+// SummerStream does around timed events.
+//
+// Prints one line per graph and thread count and exits with 1 if any of them differ.
+// Build it the same way as benchmarks/MinimBench.cpp, from the root of the repository:
+//
+//     g++ -std=c++11 -O2 -DPOSIX -Isrc -Isrc/interfaces -Isrc/ugens -o UGenScheduleTest tests/UGenScheduleTest.cpp
+//         src/AudioFormat.cpp src/AudioOutput.cpp src/AudioRecorder.cpp src/AudioSource.cpp
+//         src/FFT.cpp src/FourierTransform.cpp src/Logging.cpp src/MixKernels.cpp
+//         src/MultiChannelBuffer.cpp src/NoteManager.cpp src/NullAudioOut.cpp
+//         src/OfflineAudioOut.cpp src/RenderThreadPool.cpp src/WindowFunction.cpp
+//         src/ugens/*.cpp -lpthread
+//
+// (all on one line).
+/////////////////////////////////////////////////////////////////////
+
+#include "AudioOutput.h"
+#include "OfflineAudioOut.h"
+#include "MultiChannelBuffer.h"
+
+#include "Multiplier.h"
+#include "Oscil.h"
+#include "Pan.h"
+#include "Summer.h"
+#include "TickRate.h"
+#include "Waves.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace Minim;
+
+namespace
+{
+	const float kSampleRate = 44100.f;
+	const int   kBlockSize	= 1024;
+	const int   kFrames		= 44100;
+
+	// a graph that is patched to an AudioOutput when it is made
+	struct Graph
+	{
+		virtual ~Graph() {}
+	};
+
+	// an LFO patched to the amplitude of a panned Oscil and of one that isn't
+	struct PanGraph : public Graph
+	{
+		PanGraph( AudioOutput & out )
+		: lfo( 2.f, 0.5f, Waves::SINE() )
+		, left( 220.f, 0.2f, Waves::SAW() )
+		, right( 330.f, 0.2f, Waves::SQUARE() )
+		, pan( -0.3f )
+		{
+			lfo.patch( left.amplitude );
+			lfo.patch( right.amplitude );
+			left.patch( pan ).patch( out );
+			right.patch( out );
+		}
+
+		Oscil	lfo;
+		Oscil	left;
+		Oscil	right;
+		Pan		pan;
+	};
+
+	// an LFO patched to the amplitude of an Oscil that a TickRate ticks and of one that it doesn't
+	struct TickRateGraph : public Graph
+	{
+		TickRateGraph( AudioOutput & out )
+		: lfo( 3.f, 0.4f, Waves::SINE() )
+		, slow( 110.f, 0.2f, Waves::TRIANGLE() )
+		, fast( 440.f, 0.1f, Waves::SINE() )
+		, rate( 0.5f )
+		, gain( 0.5f )
+		{
+			lfo.patch( slow.amplitude );
+			lfo.patch( fast.amplitude );
+			slow.patch( rate ).patch( out );
+			fast.patch( gain ).patch( out );
+		}
+
+		Oscil		lfo;
+		Oscil		slow;
+		Oscil		fast;
+		TickRate	rate;
+		Multiplier	gain;
+	};
+
+	// an LFO patched to the frequency of one Oscil at a control rate and of another at the sample rate,
+	// next to a vibrato that only one Oscil uses, which can be rendered in parallel.
+	struct ControlRateGraph : public Graph
+	{
+		ControlRateGraph( AudioOutput & out )
+		: lfo( 5.f, 20.f, Waves::SINE() )
+		, vibrato( 6.f, 10.f, Waves::SINE() )
+		, a( 220.f, 0.2f, Waves::SAW() )
+		, b( 275.f, 0.2f, Waves::SQUARE() )
+		, c( 330.f, 0.2f, Waves::TRIANGLE() )
+		{
+			lfo.offset.setLastValue( 220.f );
+			lfo.patch( a.frequency );
+			a.frequency.setControlRate( 16 );
+			lfo.patch( b.frequency );
+
+			vibrato.offset.setLastValue( 330.f );
+			vibrato.patch( c.frequency );
+			c.frequency.setControlRate( 32 );
+
+			a.patch( out );
+			b.patch( mix );
+			c.patch( mix );
+			mix.patch( out );
+		}
+
+		Oscil	lfo;
+		Oscil	vibrato;
+		Oscil	a;
+		Oscil	b;
+		Oscil	c;
+		Summer	mix;
+	};
+
+	// the same, minus the LFO shared with the sample rate Oscil,
+	// so that nothing is ticked from more than one place.
+	struct PrivateGraph : public Graph
+	{
+		PrivateGraph( AudioOutput & out )
+		: vibrato( 6.f, 10.f, Waves::SINE() )
+		, trem( 4.f, 0.1f, Waves::SINE() )
+		, a( 220.f, 0.2f, Waves::SAW() )
+		, b( 330.f, 0.2f, Waves::TRIANGLE() )
+		, rate( 0.75f )
+		{
+			vibrato.offset.setLastValue( 220.f );
+			vibrato.patch( a.frequency );
+			a.frequency.setControlRate( 16 );
+
+			trem.offset.setLastValue( 0.2f );
+			trem.patch( b.amplitude );
+
+			a.patch( out );
+			b.patch( rate ).patch( out );
+		}
+
+		Oscil		vibrato;
+		Oscil		trem;
+		Oscil		a;
+		Oscil		b;
+		TickRate	rate;
+	};
+
+	typedef Graph * (*MakeGraph)( AudioOutput & out );
+
+	template<typename T>
+	Graph * make( AudioOutput & out ) { return new T( out ); }
+
+	struct Test
+	{
+		const char * name;
+		MakeGraph	 make;
+	};
+
+	const Test kTests[] =
+	{
+		{ "Pan", &make<PanGraph> },
+		{ "TickRate", &make<TickRateGraph> },
+		{ "control rate", &make<ControlRateGraph> },
+		{ "private", &make<PrivateGraph> },
+	};
+
+	void render( const Test & test, const int threadCount, MultiChannelBuffer & result )
+	{
+		static const int kBlockFrames[] = { 512, 256, 333, 1024, 100, 77 };
+		static const int kBlockCount = sizeof(kBlockFrames) / sizeof(kBlockFrames[0]);
+
+		OfflineAudioOut * offline = new OfflineAudioOut( AudioFormat( kSampleRate, 2 ), kBlockSize );
+		AudioOutput * out = new AudioOutput( offline );
+		out->setRenderThreadCount( threadCount );
+
+		Graph * graph = test.make( *out );
+
+		result.setBufferSize( kFrames );
+		MultiChannelBuffer block( 2, kBlockSize );
+		int frame = 0;
+		for( int b = 0; frame < kFrames; ++b )
+		{
+			int frames = kBlockFrames[ b % kBlockCount ];
+			if ( frames > kFrames - frame )
+			{
+				frames = kFrames - frame;
+			}
+
+			block.setBufferSize( frames );
+			offline->render( block );
+			for( int c = 0; c < 2; ++c )
+			{
+				memcpy( result.getChannel(c) + frame, block.getChannel(c), sizeof(float)*frames );
+			}
+			frame += frames;
+		}
+
+		delete graph;
+		delete out;
+	}
+}
+
+int main()
+{
+	int failures = 0;
+
+	const int testCount = sizeof(kTests) / sizeof(kTests[0]);
+	for( int t = 0; t < testCount; ++t )
+	{
+		MultiChannelBuffer serial( 2, kFrames );
+		render( kTests[t], 0, serial );
+
+		for( int threadCount = 1; threadCount <= 3; ++threadCount )
+		{
+			MultiChannelBuffer parallel( 2, kFrames );
+			render( kTests[t], threadCount, parallel );
+
+			int differ = 0;
+			for( int c = 0; c < 2; ++c )
+			{
+				differ += memcmp( serial.getChannel(c), parallel.getChannel(c), sizeof(float)*kFrames ) != 0;
+			}
+
+			printf( "%-14s %d threads: %s\n", kTests[t].name, threadCount, differ ? "FAILED" : "ok" );
+			failures += differ ? 1 : 0;
+		}
+	}
+
+	return failures ? 1 : 0;
+}